@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "SPSCQueue.hpp"
+#include "config.hpp"
+
+namespace Audio {
+constexpr unsigned SAMPLE_RATE = 44100;
+constexpr uint16_t DEFAULT_BUFFER_FRAMES = 512;
+constexpr std::size_t MIN_BUFFER_FRAMES = 64;
+constexpr std::size_t MAX_BUFFER_FRAMES = 8192;
+constexpr std::size_t EVENT_QUEUE_SIZE = 256;
+
+// everything the synthesizer needs to know about the emulator
+struct SoundState {
+  std::array<uint8_t, Emulator::AUDIO_PATTERN_SIZE> pattern;
+  uint8_t pitch;
+  bool playing;
+
+  bool operator==(const SoundState &) const = default;
+};
+
+// a sound state change, stamped with the emulated cycle it happened at
+struct SoundEvent {
+  uint64_t cycle;
+  double cycles_per_second;
+  SoundState state;
+};
+
+using EventQueue = SPSCQueue<SoundEvent, EVENT_QUEUE_SIZE>;
+
+// a device buffer size SDL accepts, rounded up to a power of two
+constexpr uint16_t buffer_frames(const std::size_t requested) {
+  return static_cast<uint16_t>(std::bit_ceil(
+      std::clamp(requested, MIN_BUFFER_FRAMES, MAX_BUFFER_FRAMES)));
+}
+
+SoundState sound_state(const auto &emulator) {
+  const auto &state = emulator.state();
+  return {state.audio_pattern, state.pitch, emulator.sound_playing()};
+}
+
+// plays the XO-CHIP 128 bit pattern buffer (a plain square wave unless a ROM
+// loads its own) and applies sound events when playback reaches their cycle
+class Synthesizer {
+public:
+  // max_lag_cycles > 0 resynchronises with the emulator when it gets that far
+  // ahead, 0 renders strictly in emulated time like a WAV dump wants
+  Synthesizer(const unsigned sample_rate, const double max_lag_cycles = 0)
+      : m_sample_rate(sample_rate), m_max_lag_cycles(max_lag_cycles) {
+    apply({});
+  }
+
+  void render(std::span<int16_t> samples, EventQueue &events) {
+    // fade in and out over ~2 ms instead of clicking
+    const auto gain_step = 1.0 / (0.002 * m_sample_rate);
+
+    for (auto &sample : samples) {
+      for (const SoundEvent *event; (event = events.front()) != nullptr;) {
+        const auto event_cycle = static_cast<double>(event->cycle);
+        if (m_max_lag_cycles > 0 &&
+            std::abs(event_cycle - m_cycle) > m_max_lag_cycles) {
+          // drifted away from the emulator (turbo, pause or a stall), resync
+          // while keeping some delay so events still land on their sample
+          m_cycle = event_cycle - m_max_lag_cycles / 2;
+        }
+        if (event_cycle > m_cycle) {
+          break;
+        }
+        apply(*event);
+        events.pop();
+      }
+
+      const auto target_gain = m_state.playing ? 1.0 : 0.0;
+      m_gain += std::clamp(target_gain - m_gain, -gain_step, gain_step);
+
+      const auto bit_index = static_cast<std::size_t>(m_phase);
+      const auto bit = (m_state.pattern[bit_index / 8] >> (7 - bit_index % 8)) & 1;
+      sample = static_cast<int16_t>((bit ? AMPLITUDE : -AMPLITUDE) * m_gain);
+
+      m_phase += m_bits_per_sample;
+      if (m_phase >= PATTERN_BITS) {
+        m_phase -= PATTERN_BITS;
+      }
+      m_cycle += m_cycles_per_sample;
+    }
+  }
+
+private:
+  static constexpr double AMPLITUDE = 8000;
+  static constexpr double PATTERN_BITS = Emulator::AUDIO_PATTERN_SIZE * 8;
+
+  void apply(const SoundEvent &event) {
+    m_state = event.state;
+    if (event.cycles_per_second > 0) {
+      m_cycles_per_sample = event.cycles_per_second / m_sample_rate;
+    }
+    // XO-CHIP plays 4000 bits per second at pitch 64, one octave per 48 steps
+    const auto bit_rate =
+        4000.0 * std::exp2((static_cast<double>(m_state.pitch) - 64.0) / 48.0);
+    m_bits_per_sample = bit_rate / m_sample_rate;
+  }
+
+  SoundState m_state{};
+  double m_sample_rate;
+  double m_max_lag_cycles;
+  double m_cycle{};
+  double m_cycles_per_sample{
+      static_cast<double>(Emulator::PROCESSOR_SPEED) / SAMPLE_RATE};
+  double m_bits_per_sample{};
+  double m_phase{};
+  double m_gain{};
+};
+
+// 16 bit mono PCM, the header gets patched with the real sizes on close
+class WavWriter {
+public:
+  WavWriter(std::string_view filename, const unsigned sample_rate)
+      : m_file(filename.data(), std::ios::binary) {
+    write_header(sample_rate, 0);
+  }
+
+  WavWriter(WavWriter &) = delete;
+  WavWriter(WavWriter &&) = delete;
+
+  ~WavWriter() {
+    m_file.seekp(0);
+    write_header(m_sample_rate, m_data_bytes);
+  }
+
+  bool is_open() const { return m_file.is_open(); }
+
+  void write(std::span<const int16_t> samples) {
+    for (const auto sample : samples) {
+      write_le(static_cast<uint16_t>(sample));
+    }
+    m_data_bytes += static_cast<uint32_t>(samples.size_bytes());
+  }
+
+private:
+  void write_header(const unsigned sample_rate, const uint32_t data_bytes) {
+    m_sample_rate = sample_rate;
+    m_file.write("RIFF", 4);
+    write_le(uint32_t{36} + data_bytes);
+    m_file.write("WAVEfmt ", 8);
+    write_le(uint32_t{16});
+    write_le(uint16_t{1}); // PCM
+    write_le(uint16_t{1}); // mono
+    write_le(uint32_t{sample_rate});
+    write_le(uint32_t{sample_rate * 2});
+    write_le(uint16_t{2});
+    write_le(uint16_t{16});
+    m_file.write("data", 4);
+    write_le(data_bytes);
+  }
+
+  template <typename VALUE_T> void write_le(const VALUE_T value) {
+    for (std::size_t i = 0; i < sizeof(VALUE_T); ++i) {
+      m_file.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+  }
+
+  std::ofstream m_file;
+  unsigned m_sample_rate{};
+  uint32_t m_data_bytes{};
+};
+
+// SDL audio device fed by a callback, see Audio_SDL.cpp. Nothing is
+// initialised until the first event that plays a sound, most ROMs start
+// silent and many never beep.
+class Output {
+public:
+  explicit Output(uint16_t buffer_frames = DEFAULT_BUFFER_FRAMES);
+
+  Output(Output &) = delete;
+  Output(Output &&) = delete;
+
+  ~Output();
+
+  bool is_open() const { return m_device != 0; }
+
+  // called from the emulator thread. If the queue is full the event is held
+  // and returns false; a later push() replaces it and it or flush() retries,
+  // so the newest state always arrives.
+  bool push(const SoundEvent &event) {
+    // a silent state before the device exists is what it starts with anyway
+    if (m_device == 0 && (!event.state.playing || !open())) {
+      return true;
+    }
+    m_pending = event;
+    return flush();
+  }
+
+  // false while an event is still held back
+  bool flush() {
+    if (m_pending.has_value() && m_events.push(m_pending.value())) {
+      m_pending.reset();
+    }
+    return !m_pending.has_value();
+  }
+
+private:
+  bool open();
+
+  static void callback(void *userdata, uint8_t *stream, int length);
+
+  EventQueue m_events;
+  std::optional<SoundEvent> m_pending;
+  Synthesizer m_synthesizer;
+  uint16_t m_buffer_frames;
+  uint32_t m_device{};
+  bool m_open_failed{};
+};
+} // namespace Audio
@@ -0,0 +1,59 @@
+#include <SDL.h>
+#include <cstdint>
+#include <span>
+
+#include "Audio.hpp"
+
+namespace Audio {
+Output::Output(const uint16_t buffer_frames)
+    // tolerate two buffers of drift before snapping to the emulator's cycle
+    : m_synthesizer(SAMPLE_RATE, 2.0 * buffer_frames * Emulator::PROCESSOR_SPEED /
+                                     SAMPLE_RATE),
+      m_buffer_frames(buffer_frames) {}
+
+bool Output::open() {
+  if (m_open_failed) {
+    return false;
+  }
+
+  if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    SDL_Log("Couldn't initialize SDL audio: %s\n", SDL_GetError());
+    m_open_failed = true;
+    return false;
+  }
+
+  SDL_AudioSpec desired{};
+  desired.freq = SAMPLE_RATE;
+  desired.format = AUDIO_S16SYS;
+  desired.channels = 1;
+  desired.samples = m_buffer_frames;
+  desired.callback = &Output::callback;
+  desired.userdata = this;
+
+  m_device = SDL_OpenAudioDevice(nullptr, 0, &desired, nullptr, 0);
+  if (m_device == 0) {
+    SDL_Log("Couldn't open audio: %s\n", SDL_GetError());
+    m_open_failed = true;
+    return false;
+  }
+
+  SDL_Log("Opened audio at %d Hz, %d frame buffer", desired.freq,
+          desired.samples);
+  SDL_PauseAudioDevice(m_device, 0);
+  return true;
+}
+
+Output::~Output() {
+  if (m_device != 0) {
+    SDL_CloseAudioDevice(m_device);
+  }
+}
+
+void Output::callback(void *userdata, uint8_t *stream, int length) {
+  auto &output = *static_cast<Output *>(userdata);
+  output.m_synthesizer.render(
+      std::span(reinterpret_cast<int16_t *>(stream),
+                static_cast<std::size_t>(length) / sizeof(int16_t)),
+      output.m_events);
+}
+} // namespace Audio
@@ -1,4 +1,4 @@
-#include <SDL.h>
+#include <algorithm>
 #include <array>
 #include <bit>
 #include <cassert>
@@ -15,38 +15,85 @@
 #include "config.hpp"
 
 namespace Emulator {
-bool CHIP8::load_rom(std::string_view filename) {
+template <typename QUIRKS_T>
+bool CHIP8<QUIRKS_T>::load_rom(std::string_view filename) {
   std::ifstream istrm(filename.data(), std::ios::binary);
   if (!istrm.is_open()) {
     return false;
   }
 
-  int bytes_read = 0;
-  for (; !istrm.eof(); bytes_read += 2) {
-    // todo: read whole program at once
-    auto *mem_bytes =
-        std::next(m_state.memory.begin(), PROGMEM_START + bytes_read);
-    istrm.read(std::bit_cast<char *>(mem_bytes), 2);
+  const std::vector<uint8_t> rom{std::istreambuf_iterator<char>(istrm),
+                                 std::istreambuf_iterator<char>()};
+  return load_rom(rom);
+}
 
-    if constexpr (DEBUG_EMULATOR) {
-      // big endian -> little endian
-      const auto bytes =
-          static_cast<uint16_t>((mem_bytes[0] << 8) | mem_bytes[1]);
-      std::cout << std::format("Read instruction #{}:  0x{:04x}\n",
-                               bytes_read / 2, bytes);
-    }
+template <typename QUIRKS_T>
+bool CHIP8<QUIRKS_T>::load_rom(std::span<const uint8_t> rom) {
+  constexpr auto max_rom_size = Quirks::memory_size - PROGMEM_START;
+  if (rom.size() > max_rom_size) {
+    rom = rom.first(max_rom_size);
   }
 
-  m_program_end_address = static_cast<uint16_t>(PROGMEM_START + bytes_read);
+  std::ranges::copy(rom, std::next(m_state.memory.begin(), PROGMEM_START));
+  m_program_end_address = static_cast<uint32_t>(PROGMEM_START + rom.size());
 
   if constexpr (DEBUG_EMULATOR) {
-    std::cout << std::format("Total instructions: {}\n", bytes_read / 2);
+    for (std::size_t i = 0; i + 1 < rom.size(); i += 2) {
+      // big endian -> little endian
+      const auto bytes = static_cast<uint16_t>((rom[i] << 8) | rom[i + 1]);
+      std::cout << std::format("Read instruction #{}:  0x{:04x}\n", i / 2,
+                               bytes);
+    }
+    std::cout << std::format("Total instructions: {}\n", instruction_count());
   }
 
   return true;
 }
 
-bool CHIP8::single_step() {
+template <typename QUIRKS_T>
+bool CHIP8<QUIRKS_T>::draw_sprite(const Instruction instruction) {
+  // DXY0 is a 16x16 sprite on SUPER-CHIP and a no-op otherwise
+  const bool large = Quirks::schip && instruction.N() == 0;
+  const std::size_t sprite_width = large ? 16 : 8;
+  const std::size_t height = large ? 16 : instruction.N();
+  const std::size_t bytes_per_plane = height * sprite_width / 8;
+
+  // sprite origin wraps, the sprite itself wraps or clips depending on quirk
+  const std::size_t x_coord =
+      m_state.registers[instruction.X()] % m_display.width();
+  const std::size_t y_coord =
+      m_state.registers[instruction.Y()] % m_display.height();
+
+  std::array<uint16_t, 16> sprite{};
+  auto address = m_state.index_register;
+  bool collision = false;
+
+  // each selected plane reads its own sprite from consecutive memory
+  for (std::size_t plane = 0; plane < Display::PLANES; ++plane) {
+    if ((m_state.plane_mask & (1 << plane)) == 0) {
+      continue;
+    }
+
+    for (std::size_t y = 0; y < height; ++y) {
+      sprite[y] = large ? static_cast<uint16_t>(
+                              (memory_at(address + y * 2) << 8) |
+                              memory_at(address + y * 2 + 1))
+                        : memory_at(address + y);
+    }
+    address += bytes_per_plane;
+
+    collision |= m_display.draw<Quirks::wrap_sprites>(
+        plane, x_coord, y_coord, std::span(sprite).first(height), sprite_width);
+  }
+
+  m_need_repaint = true;
+  return collision;
+}
+
+template <typename QUIRKS_T>
+bool CHIP8<QUIRKS_T>::single_step() {
+  ++m_cycle_count;
+  m_state.program_counter &= address_mask;
   const auto instruction_address = m_state.program_counter;
 
   if (instruction_address > m_program_end_address) {
@@ -56,7 +103,7 @@ bool CHIP8::single_step() {
           "Total instructions: {}\n",
           instruction_address, instruction_count());
     }
-    return false;
+    return fault(Fault::OutOfProgram);
   }
 
   const auto instruction = Instruction(m_state.memory, instruction_address);
@@ -69,15 +116,40 @@ bool CHIP8::single_step() {
 
   switch (instruction.opcode()) {
   case 0x0:
-    if (instruction.Y() == 0x0) {
-      m_state.program_counter -= 2;
-    } else if (instruction.NN() == 0xE0) {
+    // 0000 halts, machine code calls (any other 0NNN) can't be emulated
+    if (instruction.value == 0x0000) {
+      return false;
+    } else if (instruction.value == 0x00E0) {
+      m_display.clear(m_state.plane_mask);
+      m_need_repaint = true;
+    } else if (instruction.value == 0x00EE) {
+      const auto return_address = m_state.stack.pop();
+      if (!return_address.has_value()) {
+        return fault(Fault::StackUnderflow);
+      }
+      m_state.program_counter = return_address.value();
+    } else if (Quirks::schip && (instruction.value & 0xFFF0) == 0x00C0) {
+      m_display.scroll_down(instruction.N(), m_state.plane_mask);
       m_need_repaint = true;
-    } else if (instruction.NN() == 0xEE) {
-      m_state.program_counter = m_state.stack.pop();
-      // return true;
-    } else if (instruction.NNN() == 0x00) {
+    } else if (Quirks::xochip && (instruction.value & 0xFFF0) == 0x00D0) {
+      m_display.scroll_up(instruction.N(), m_state.plane_mask);
+      m_need_repaint = true;
+    } else if (Quirks::schip && instruction.value == 0x00FB) {
+      m_display.scroll_right(4, m_state.plane_mask);
+      m_need_repaint = true;
+    } else if (Quirks::schip && instruction.value == 0x00FC) {
+      m_display.scroll_left(4, m_state.plane_mask);
+      m_need_repaint = true;
+    } else if (Quirks::schip && instruction.value == 0x00FD) {
       return false;
+    } else if (Quirks::schip && instruction.value == 0x00FE) {
+      m_display.set_hires(false);
+      m_need_repaint = true;
+    } else if (Quirks::schip && instruction.value == 0x00FF) {
+      m_display.set_hires(true);
+      m_need_repaint = true;
+    } else {
+      return unknown_instruction(instruction);
     }
     break;
   case 0x1: {
@@ -85,28 +157,51 @@ bool CHIP8::single_step() {
     return true;
   }
   case 0x2: {
-    m_state.stack.push(m_state.program_counter);
+    if (!m_state.stack.push(m_state.program_counter)) {
+      return fault(Fault::StackOverflow);
+    }
     m_state.program_counter = instruction.NNN();
     return true;
   }
   case 0x3: {
     if (m_state.registers[instruction.X()] == instruction.NN()) {
-      m_state.program_counter += 2;
+      skip_instruction();
     }
 
     break;
   }
   case 0x4: {
     if (m_state.registers[instruction.X()] != instruction.NN()) {
-      m_state.program_counter += 2;
+      skip_instruction();
     }
 
     break;
   }
   case 0x5: {
+    if (Quirks::xochip && (instruction.N() == 0x2 || instruction.N() == 0x3)) {
+      // save/load the VX..VY range at I, in either direction
+      const bool save = instruction.N() == 0x2;
+      const auto from = instruction.X();
+      const auto to = instruction.Y();
+      const std::size_t count = (from <= to ? to - from : from - to) + 1u;
+      for (std::size_t i = 0; i < count; ++i) {
+        const auto reg = from <= to ? from + i : from - i;
+        auto &memory = memory_at(m_state.index_register + i);
+        if (save) {
+          memory = m_state.registers[reg];
+        } else {
+          m_state.registers[reg] = memory;
+        }
+      }
+      break;
+    }
+    if (instruction.N() != 0x0) {
+      return unknown_instruction(instruction);
+    }
+
     if (m_state.registers[instruction.X()] ==
         m_state.registers[instruction.Y()]) {
-      m_state.program_counter += 2;
+      skip_instruction();
     }
 
     break;
@@ -126,12 +221,21 @@ bool CHIP8::single_step() {
       break;
     case 0x1:
       m_state.registers[instruction.X()] |= m_state.registers[instruction.Y()];
+      if constexpr (Quirks::logic_resets_vf) {
+        m_state.registers[0xF] = 0;
+      }
       break;
     case 0x2:
       m_state.registers[instruction.X()] &= m_state.registers[instruction.Y()];
+      if constexpr (Quirks::logic_resets_vf) {
+        m_state.registers[0xF] = 0;
+      }
       break;
     case 0x3:
       m_state.registers[instruction.X()] ^= m_state.registers[instruction.Y()];
+      if constexpr (Quirks::logic_resets_vf) {
+        m_state.registers[0xF] = 0;
+      }
       break;
     case 0x4: {
       const uint8_t old_x = m_state.registers[instruction.X()];
@@ -153,6 +257,9 @@ bool CHIP8::single_step() {
     }
 
     case 0x6:
+      if constexpr (Quirks::shift_vy) {
+        m_state.registers[instruction.X()] = m_state.registers[instruction.Y()];
+      }
       m_state.registers[0xF] = (m_state.registers[instruction.X()] & 1);
       m_state.registers[instruction.X()] >>= 1;
       break;
@@ -167,17 +274,22 @@ bool CHIP8::single_step() {
       break;
     }
     case 0xE:
+      if constexpr (Quirks::shift_vy) {
+        m_state.registers[instruction.X()] = m_state.registers[instruction.Y()];
+      }
       m_state.registers[0xF] = (m_state.registers[instruction.X()] >> 7);
       m_state.registers[instruction.X()] =
           static_cast<uint8_t>(m_state.registers[instruction.X()] << 1);
       break;
+    default:
+      return unknown_instruction(instruction);
     }
     break;
   }
   case 0x9: {
     if (m_state.registers[instruction.X()] !=
         m_state.registers[instruction.Y()]) {
-      m_state.program_counter += 2;
+      skip_instruction();
     }
 
     break;
@@ -187,7 +299,12 @@ bool CHIP8::single_step() {
     break;
   }
   case 0xB: {
-    m_state.program_counter = m_state.registers[0] + instruction.NNN();
+    if constexpr (Quirks::jump_uses_vx) {
+      m_state.program_counter =
+          m_state.registers[instruction.X()] + instruction.NNN();
+    } else {
+      m_state.program_counter = m_state.registers[0] + instruction.NNN();
+    }
     return true;
   }
   case 0xC: {
@@ -199,71 +316,71 @@ bool CHIP8::single_step() {
   }
 
   case 0xD: {
-    m_state.registers[0xF] = 0;
-
-    // wrap coordinates outside of screen
-    const std::size_t x_coord = m_state.registers[instruction.X()] & 63;
-    const std::size_t y_coord = m_state.registers[instruction.Y()] & 31;
-    const std::size_t height = instruction.N();
-
-    constexpr auto sprite_width = 8;
-
-    for (std::size_t y = 0; y < height; ++y) {
-      if (y + y_coord >= HEIGHT) {
-        break;
-      }
-
-      // each address contains values for 8 pixels
-      const auto value_at_index = m_state.memory[m_state.index_register + y];
-
-      for (std::size_t x = 0; x < sprite_width; ++x) {
-        const auto pixel_index = (y_coord + y) * WIDTH + x + x_coord;
-
-        if (x + x_coord >= WIDTH) {
-          break;
-        }
-
-        // read pixels left to right
-        const uint8_t index_pixel_bit_value =
-            (value_at_index >> (sprite_width - 1 - x)) & 1;
-
-        // check if a pixel will get unset (both memory and screen pixel have 1)
-        m_state.registers[0xF] |= static_cast<uint8_t>(
-            (index_pixel_bit_value == 1 && m_pixels[pixel_index] == 1));
-
-        m_pixels[pixel_index] ^= index_pixel_bit_value;
+    if constexpr (Quirks::display_wait) {
+      // retry the instruction until the next timer tick
+      if (!m_vblank) {
+        return true;
       }
+      m_vblank = false;
     }
 
+    m_state.registers[0xF] = draw_sprite(instruction) ? 1 : 0;
     break;
   }
   case 0xE:
     if (instruction.NN() == 0x9E) {
-      if (m_last_key.has_value() &&
-          m_last_key.value() == m_state.registers[instruction.X()]) {
-        m_last_key.reset();
-        m_state.program_counter += 2;
+      if (m_keys & (1 << (m_state.registers[instruction.X()] & 0xF))) {
+        skip_instruction();
       }
     } else if (instruction.NN() == 0xA1) {
-      if (m_last_key.has_value() &&
-          m_last_key.value() != m_state.registers[instruction.X()]) {
-        m_last_key.reset();
-        m_state.program_counter += 2;
+      if (!(m_keys & (1 << (m_state.registers[instruction.X()] & 0xF)))) {
+        skip_instruction();
       }
+    } else {
+      return unknown_instruction(instruction);
     }
     break;
   case 0xF: {
     switch (instruction.NN()) {
+    case 0x00:
+      // F000 NNNN: load a 16 bit address from the next word
+      if (!Quirks::xochip || instruction.X() != 0x0) {
+        return unknown_instruction(instruction);
+      }
+      m_state.program_counter += 2;
+      m_state.index_register =
+          Instruction(m_state.memory, m_state.program_counter).value;
+      break;
+    case 0x01:
+      if constexpr (Quirks::xochip) {
+        m_state.plane_mask = instruction.X() & Display::ALL_PLANES;
+      } else {
+        return unknown_instruction(instruction);
+      }
+      break;
+    case 0x02:
+      if (!Quirks::xochip || instruction.X() != 0x0) {
+        return unknown_instruction(instruction);
+      }
+      for (std::size_t i = 0; i < m_state.audio_pattern.size(); ++i) {
+        m_state.audio_pattern[i] = memory_at(m_state.index_register + i);
+      }
+      break;
     case 0x07:
       m_state.registers[instruction.X()] = m_state.delay_timer;
       break;
     case 0x0A:
-      if (!m_last_key.has_value()) {
-        m_waiting_for_keypress = true;
+      if (!m_awaited_key.has_value()) {
+        if (m_keys != 0) {
+          m_awaited_key = static_cast<uint8_t>(std::countr_zero(m_keys));
+        }
         return true; // simulated blocking
       }
-      m_state.registers[instruction.X()] = m_last_key.value();
-      m_last_key.reset();
+      if (m_keys & (1 << m_awaited_key.value())) {
+        return true; // wait for the release
+      }
+      m_state.registers[instruction.X()] = m_awaited_key.value();
+      m_awaited_key.reset();
       break;
     case 0x15:
       m_state.delay_timer = m_state.registers[instruction.X()];
@@ -275,21 +392,39 @@ bool CHIP8::single_step() {
       m_state.index_register += m_state.registers[instruction.X()];
       break;
     case 0x29:
-      m_state.index_register = m_state.registers[instruction.X()] * 5;
+      m_state.index_register = (m_state.registers[instruction.X()] & 0xF) * 5;
+      break;
+    case 0x30:
+      if constexpr (Quirks::schip) {
+        m_state.index_register =
+            BIG_FONT_START + (m_state.registers[instruction.X()] & 0xF) * 10;
+      } else {
+        return unknown_instruction(instruction);
+      }
+      break;
+    case 0x3A:
+      if constexpr (Quirks::xochip) {
+        m_state.pitch = m_state.registers[instruction.X()];
+      } else {
+        return unknown_instruction(instruction);
+      }
       break;
     case 0x33:
-      m_state.memory[m_state.index_register + 2] =
+      memory_at(m_state.index_register + 2) =
           m_state.registers[instruction.X()] % 10;
-      m_state.memory[m_state.index_register + 1] =
+      memory_at(m_state.index_register + 1) =
           (m_state.registers[instruction.X()] / 10) % 10;
-      m_state.memory[m_state.index_register] =
+      memory_at(m_state.index_register) =
           m_state.registers[instruction.X()] / 100;
       break;
     case 0x55:
       for (std::size_t i = m_state.index_register;
            const auto reg :
            m_state.registers | std::ranges::views::take(instruction.X() + 1)) {
-        m_state.memory[i++] = reg;
+        memory_at(i++) = reg;
+      }
+      if constexpr (Quirks::load_store_increments_i) {
+        m_state.index_register += instruction.X() + 1u;
       }
       break;
 
@@ -297,19 +432,41 @@ bool CHIP8::single_step() {
       for (std::size_t i = m_state.index_register;
            auto &reg :
            m_state.registers | std::ranges::views::take(instruction.X() + 1)) {
-        reg = m_state.memory[i++];
+        reg = memory_at(i++);
+      }
+      if constexpr (Quirks::load_store_increments_i) {
+        m_state.index_register += instruction.X() + 1u;
+      }
+      break;
+    case 0x75:
+      if constexpr (Quirks::schip) {
+        std::copy_n(m_state.registers.begin(), instruction.X() + 1,
+                    m_state.rpl_flags.begin());
+      } else {
+        return unknown_instruction(instruction);
       }
       break;
+    case 0x85:
+      if constexpr (Quirks::schip) {
+        std::copy_n(m_state.rpl_flags.begin(), instruction.X() + 1,
+                    m_state.registers.begin());
+      } else {
+        return unknown_instruction(instruction);
+      }
+      break;
+    default:
+      return unknown_instruction(instruction);
     }
     break;
   }
-  default:
-    std::cout << std::format("Unknown opcode: {:x} (0x{:x})\n",
-                             instruction.opcode(), instruction.value);
-    return false;
   }
   m_state.program_counter += 2;
 
   return true;
 }
+
+template class CHIP8<Quirks::Modern>;
+template class CHIP8<Quirks::CHIP8>;
+template class CHIP8<Quirks::SuperChip>;
+template class CHIP8<Quirks::XOChip>;
 } // namespace Emulator
\ No newline at end of file
@@ -1,5 +1,8 @@
+#pragma once
+
+#include "Display.hpp"
+#include "Quirks.hpp"
 #include "config.hpp"
-#include <SDL.h>
 #include <array>
 #include <bit>
 #include <cassert>
@@ -8,8 +11,10 @@
 #include <format>
 #include <fstream>
 #include <iostream>
-#include <vector>
 #include <optional>
+#include <span>
+#include <variant>
+#include <vector>
 
 #ifndef DEBUG_EMULATOR
 #define DEBUG_EMULATOR 0
@@ -18,8 +23,9 @@
 namespace Emulator {
 struct Instruction {
   constexpr Instruction(const auto &memory, const auto address) {
-    const auto * mem_bytes = std::next(memory.begin(), address);
-    value = static_cast<uint16_t>((mem_bytes[0] << 8) | mem_bytes[1]);
+    const auto mask = memory.size() - 1;
+    value = static_cast<uint16_t>((memory[address & mask] << 8) |
+                                  memory[(address + 1) & mask]);
   }
   auto opcode() const { return static_cast<uint8_t>(value >> 12); }
   auto X() const { return static_cast<uint8_t>((value >> 8) & 0x0F); }
@@ -31,18 +37,40 @@ struct Instruction {
   uint16_t value;
 };
 
+// reasons for the machine to stop, reported instead of throwing so the core
+// can be built with -fno-exceptions. 0000 and SUPER-CHIP's 00FD are the
+// program exiting: single_step() returns false with the fault left at None.
+enum class Fault : uint8_t {
+  None,
+  StackOverflow,
+  StackUnderflow,
+  OutOfProgram,
+  UnknownInstruction,
+};
+
 template<typename VALUE_T>
 class Stack {
 public:
-  void push(VALUE_T value) {
-    m_stack.at(m_pointer) = value;
-    ++m_pointer;
+  [[nodiscard]] bool push(VALUE_T value) {
+    if (m_pointer == m_stack.size()) {
+      return false;
+    }
+    m_stack[m_pointer++] = value;
+    return true;
   }
 
-  auto pop() {
-    const auto value = m_stack.at(m_pointer - 1);
-    --m_pointer;
-    return value;
+  [[nodiscard]] std::optional<VALUE_T> pop() {
+    if (m_pointer == 0) {
+      return std::nullopt;
+    }
+    return m_stack[--m_pointer];
+  }
+
+  std::size_t size() const { return m_pointer; }
+
+  // return addresses currently on the stack, outermost call first
+  std::span<const VALUE_T> entries() const {
+    return std::span(m_stack).first(m_pointer);
   }
 
 private:
@@ -50,26 +78,43 @@ private:
   std::size_t m_pointer{};
 };
 
+template <std::size_t MEMORY_BYTES>
 struct State {
-  std::array<uint8_t, MEMORY_SIZE> memory;
+  std::array<uint8_t, MEMORY_BYTES> memory;
   Stack<uint32_t> stack;
   std::array<uint8_t, REG_COUNT> registers;
+  std::array<uint8_t, RPL_FLAG_COUNT> rpl_flags;
+  std::array<uint8_t, AUDIO_PATTERN_SIZE> audio_pattern;
   std::size_t index_register;
   uint32_t program_counter;
   uint16_t stack_counter;
   uint8_t sound_timer;
   uint8_t delay_timer;
+  uint8_t pitch;
+  uint8_t plane_mask;
+  Fault fault;
 };
 
+template <typename QUIRKS_T = Quirks::Modern>
 class CHIP8 {
 public:
+  using Quirks = QUIRKS_T;
+
   constexpr CHIP8() {
     m_state.program_counter = PROGMEM_START;
     for (std::size_t i = 0; i < font.size(); ++i) {
       m_state.memory[i] = font[i];
     }
+    for (std::size_t i = 0; i < big_font.size(); ++i) {
+      m_state.memory[BIG_FONT_START + i] = big_font[i];
+    }
+    // a 500 Hz square wave at the default pitch
+    m_state.audio_pattern.fill(0xF0);
+    m_state.pitch = DEFAULT_PITCH;
+    m_state.plane_mask = 1;
   }
   bool load_rom(std::string_view filename);
+  bool load_rom(std::span<const uint8_t> rom);
 
   bool single_step();
 
@@ -80,39 +125,106 @@ public:
     if (m_state.sound_timer > 0) {
       --m_state.sound_timer;
     }
+    m_vblank = true;
   }
 
   bool sound_playing() const {
     return m_state.sound_timer > 0;
   }
 
-  uint8_t get_pixel(const auto coordinate) const {
-    return m_pixels.at(coordinate);
-  }
+  // instructions executed so far, the emulator's notion of time
+  uint64_t cycle_count() const { return m_cycle_count; }
 
-  bool need_clear_screen() const {
+  const Display &display() const { return m_display; }
+
+  bool need_repaint() const {
     return m_need_repaint;
   }
 
-  void set_need_clear_screen(const bool value) {
+  void set_need_repaint(const bool value) {
     m_need_repaint = value;
   }
 
-  void set_last_key(const uint8_t key) {
-    m_last_key = key;
+  // keypad state, bit n set while key n is held down
+  uint16_t keys() const { return m_keys; }
+
+  void set_keys(const uint16_t keys) {
+    m_keys = keys;
+  }
+
+  void set_key(const uint8_t key, const bool pressed) {
+    const auto bit = static_cast<uint16_t>(1 << (key & 0xF));
+    m_keys = static_cast<uint16_t>(pressed ? m_keys | bit : m_keys & ~bit);
   }
 
+  const auto &state() const { return m_state; }
+
+  Fault fault() const { return m_state.fault; }
+
 private:
+  static constexpr std::size_t address_mask = Quirks::memory_size - 1;
+
+  uint8_t &memory_at(const std::size_t address) {
+    return m_state.memory[address & address_mask];
+  }
+
+  bool fault(const Fault fault) {
+    m_state.fault = fault;
+    return false;
+  }
+
+  bool unknown_instruction(const Instruction instruction) {
+    if constexpr (DEBUG_EMULATOR) {
+      std::cout << std::format("Unknown instruction: 0x{:04x}\n",
+                               instruction.value);
+    }
+    return fault(Fault::UnknownInstruction);
+  }
+
+  // skips the next instruction, which is twice as long if it is F000 NNNN
+  void skip_instruction() {
+    if constexpr (Quirks::xochip) {
+      if (Instruction(m_state.memory, m_state.program_counter + 2).value ==
+          0xF000) {
+        m_state.program_counter += 2;
+      }
+    }
+    m_state.program_counter += 2;
+  }
+
+  bool draw_sprite(Instruction instruction);
+
   uint32_t instruction_count() const {
     return (m_program_end_address - PROGMEM_START) / 2;
   }
 
-  State m_state{};
-  std::array<uint8_t, WIDTH * HEIGHT> m_pixels;
+  State<Quirks::memory_size> m_state{};
+  Display m_display;
   std::vector<Instruction> m_instructions;
-  std::optional<uint8_t> m_last_key;
-  uint16_t m_program_end_address;
-  bool m_need_repaint{false};
-  bool m_waiting_for_keypress{false};
+  // FX0A latches the first key pressed and completes once it is released
+  std::optional<uint8_t> m_awaited_key;
+  uint32_t m_program_end_address{};
+  uint64_t m_cycle_count{};
+  uint16_t m_keys{};
+  bool m_need_repaint{true};
+  bool m_vblank{false};
 };
+
+// every profile the core is pre-instantiated for, selected at runtime
+using AnyCHIP8 = std::variant<CHIP8<Quirks::Modern>, CHIP8<Quirks::CHIP8>,
+                              CHIP8<Quirks::SuperChip>, CHIP8<Quirks::XOChip>>;
+
+constexpr AnyCHIP8 make_emulator(const Profile profile) {
+  switch (profile) {
+  case Profile::CHIP8:
+    return CHIP8<Quirks::CHIP8>{};
+  case Profile::SuperChip:
+    return CHIP8<Quirks::SuperChip>{};
+  case Profile::XOChip:
+    return CHIP8<Quirks::XOChip>{};
+  case Profile::Modern:
+  default:
+    return CHIP8<Quirks::Modern>{};
+  }
+}
 } // namespace Emulator
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "CHIP8.hpp"
+#include "CHIP8_API.h"
+#include "config.hpp"
+
+namespace {
+constexpr uint32_t DEFAULT_SPIN_ITERATIONS = 4096;
+constexpr std::size_t SEGMENT_ALIGNMENT = 64;
+constexpr double CYCLES_PER_TICK = Emulator::PROCESSOR_SPEED / 60.0;
+
+constexpr std::size_t align_up(const std::size_t value) {
+  return (value + SEGMENT_ALIGNMENT - 1) & ~(SEGMENT_ALIGNMENT - 1);
+}
+
+// header, then the core, then room for the largest ROM
+constexpr std::size_t CORE_OFFSET = align_up(sizeof(chip8_shm));
+constexpr std::size_t ROM_OFFSET =
+    CORE_OFFSET + align_up(sizeof(Emulator::AnyCHIP8));
+constexpr std::size_t SEGMENT_SIZE =
+    align_up(ROM_OFFSET + Emulator::XO_MEMORY_SIZE - Emulator::PROGMEM_START);
+
+auto *segment_base(chip8_shm *shm) { return reinterpret_cast<uint8_t *>(shm); }
+
+auto &core(chip8_shm *shm) {
+  return *std::launder(reinterpret_cast<Emulator::AnyCHIP8 *>(
+      segment_base(shm) + shm->core_offset));
+}
+
+std::span<const uint8_t> rom(chip8_shm *shm) {
+  return {segment_base(shm) + shm->rom_offset, shm->rom_size};
+}
+
+std::atomic_ref<uint32_t> doorbell(uint32_t &word) {
+  return std::atomic_ref<uint32_t>(word);
+}
+
+// shared (not FUTEX_PRIVATE) so it works across processes
+void futex_wait(uint32_t &word, const uint32_t expected) {
+  syscall(SYS_futex, &word, FUTEX_WAIT, expected, nullptr, nullptr, 0);
+}
+
+void futex_wake(uint32_t &word) {
+  syscall(SYS_futex, &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// blocks until word != value, returns the new value
+uint32_t wait_for_change(chip8_shm *shm, uint32_t &word, const uint32_t value) {
+  for (uint32_t spin = 0; spin < shm->spin_iterations; ++spin) {
+    const auto current = doorbell(word).load(std::memory_order_acquire);
+    if (current != value) {
+      return current;
+    }
+    cpu_relax();
+  }
+
+  for (;;) {
+    const auto current = doorbell(word).load(std::memory_order_acquire);
+    if (current != value) {
+      return current;
+    }
+    futex_wait(word, value);
+  }
+}
+
+// points the header at the core's live state and copies out the scalars
+void publish(chip8_shm *shm) {
+  std::visit(
+      [shm](const auto &emulator) {
+        const auto &state = emulator.state();
+        const auto &display = emulator.display();
+        const auto offset_of = [shm](const void *pointer) {
+          return static_cast<uint32_t>(static_cast<const uint8_t *>(pointer) -
+                                       segment_base(shm));
+        };
+
+        shm->fault = static_cast<uint32_t>(emulator.fault());
+        shm->cycle = emulator.cycle_count();
+        shm->program_counter = state.program_counter;
+        shm->index_register = static_cast<uint32_t>(state.index_register);
+        shm->delay_timer = state.delay_timer;
+        shm->sound_timer = state.sound_timer;
+        shm->hires = display.hires();
+        shm->plane_count = Emulator::Display::PLANES;
+        shm->width = static_cast<uint16_t>(display.width());
+        shm->height = static_cast<uint16_t>(display.height());
+
+        shm->memory_offset = offset_of(state.memory.data());
+        shm->memory_size = static_cast<uint32_t>(state.memory.size());
+        shm->registers_offset = offset_of(state.registers.data());
+        shm->framebuffer_offset = offset_of(&display.row(0, 0));
+        shm->framebuffer_row_stride =
+            offset_of(&display.row(0, 1)) - shm->framebuffer_offset;
+        shm->framebuffer_plane_stride =
+            offset_of(&display.row(1, 0)) - shm->framebuffer_offset;
+      },
+      core(shm));
+}
+
+void reset(chip8_shm *shm) {
+  auto &emulator = core(shm);
+  emulator = Emulator::make_emulator(static_cast<Emulator::Profile>(shm->profile));
+  std::visit([shm](auto &emulator) { emulator.load_rom(rom(shm)); }, emulator);
+  shm->frame = 0;
+  shm->next_tick = 0;
+  shm->status = CHIP8_STATUS_OK;
+  publish(shm);
+}
+
+void step(chip8_shm *shm) {
+  shm->status = std::visit(
+      [shm](auto &emulator) {
+        emulator.set_keys(shm->keymask);
+        // PROCESSOR_SPEED / 60 isn't whole, so a frame is a timer tick and
+        // the instructions up to the next one, as in run_headless
+        for (uint32_t frame = 0; frame < shm->n_frames; ++frame) {
+          emulator.timer_tick();
+          shm->next_tick += CYCLES_PER_TICK;
+          while (static_cast<double>(emulator.cycle_count()) < shm->next_tick) {
+            if (!emulator.single_step()) {
+              return CHIP8_STATUS_HALTED;
+            }
+          }
+          ++shm->frame;
+        }
+        return CHIP8_STATUS_OK;
+      },
+      core(shm));
+  publish(shm);
+}
+
+void execute(chip8_shm *shm, const uint32_t command) {
+  switch (command) {
+  case CHIP8_COMMAND_STEP:
+    step(shm);
+    break;
+  case CHIP8_COMMAND_RESET:
+    reset(shm);
+    break;
+  case CHIP8_COMMAND_QUIT:
+    shm->status = CHIP8_STATUS_OK;
+    break;
+  default:
+    shm->status = CHIP8_STATUS_ERROR;
+    break;
+  }
+}
+
+// fills in the header and constructs the core in a zeroed segment
+bool initialise(chip8_shm *shm, const int profile,
+                std::span<const uint8_t> rom_bytes) {
+  if (profile < CHIP8_PROFILE_MODERN || profile > CHIP8_PROFILE_XOCHIP ||
+      rom_bytes.size() > SEGMENT_SIZE - ROM_OFFSET) {
+    return false;
+  }
+
+  shm->version = CHIP8_SHM_VERSION;
+  shm->segment_size = SEGMENT_SIZE;
+  // spinning only helps when the other side can run at the same time
+  shm->spin_iterations =
+      sysconf(_SC_NPROCESSORS_ONLN) > 1 ? DEFAULT_SPIN_ITERATIONS : 0;
+  shm->profile = static_cast<uint32_t>(profile);
+  shm->core_offset = CORE_OFFSET;
+  shm->rom_offset = ROM_OFFSET;
+  shm->rom_size = static_cast<uint32_t>(rom_bytes.size());
+  std::memcpy(segment_base(shm) + ROM_OFFSET, rom_bytes.data(),
+              rom_bytes.size());
+
+  new (segment_base(shm) + CORE_OFFSET) Emulator::AnyCHIP8();
+  reset(shm);
+
+  // attachers wait for the magic, publish it last
+  doorbell(shm->magic).store(CHIP8_SHM_MAGIC, std::memory_order_release);
+  return true;
+}
+
+int request(chip8_shm *shm, const uint32_t command) {
+  shm->command = command;
+
+  if (shm->in_process) {
+    execute(shm, command);
+    return shm->status;
+  }
+
+  const auto sequence =
+      doorbell(shm->request_seq).load(std::memory_order_relaxed) + 1;
+  doorbell(shm->request_seq).store(sequence, std::memory_order_release);
+  futex_wake(shm->request_seq);
+
+  for (auto answered = sequence - 1; answered != sequence;) {
+    answered = wait_for_change(shm, shm->response_seq, answered);
+  }
+  return shm->status;
+}
+} // namespace
+
+extern "C" {
+chip8_shm *chip8_create(const int profile, const uint8_t *rom_bytes,
+                        const size_t rom_size) {
+  auto *memory = std::aligned_alloc(SEGMENT_ALIGNMENT, SEGMENT_SIZE);
+  if (memory == nullptr) {
+    return nullptr;
+  }
+  std::memset(memory, 0, SEGMENT_SIZE);
+
+  auto *shm = static_cast<chip8_shm *>(memory);
+  shm->in_process = 1;
+  if (!initialise(shm, profile, {rom_bytes, rom_size})) {
+    std::free(memory);
+    return nullptr;
+  }
+  return shm;
+}
+
+int chip8_shm_serve(const char *name, const int profile, const char *rom_path) {
+  std::ifstream istrm(rom_path, std::ios::binary);
+  if (!istrm.is_open()) {
+    std::cout << "Could not open ROM: " << rom_path << '\n';
+    return 1;
+  }
+  const std::vector<uint8_t> rom_bytes{std::istreambuf_iterator<char>(istrm),
+                                       std::istreambuf_iterator<char>()};
+
+  const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 || ftruncate(fd, SEGMENT_SIZE) < 0) {
+    std::cout << "Could not create shared memory " << name << '\n';
+    if (fd >= 0) {
+      close(fd);
+      shm_unlink(name);
+    }
+    return 1;
+  }
+
+  void *memory =
+      mmap(nullptr, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(name);
+    return 1;
+  }
+
+  auto *shm = static_cast<chip8_shm *>(memory);
+  if (!initialise(shm, profile, rom_bytes)) {
+    munmap(memory, SEGMENT_SIZE);
+    shm_unlink(name);
+    return 1;
+  }
+
+  std::cout << "Serving " << name << '\n';
+
+  for (uint32_t sequence = 0;;) {
+    sequence = wait_for_change(shm, shm->request_seq, sequence);
+    // once response_seq is stored the client may already be writing its next
+    // request, nothing of this one can be read back after that
+    const auto command = shm->command;
+    execute(shm, command);
+
+    doorbell(shm->response_seq).store(sequence, std::memory_order_release);
+    futex_wake(shm->response_seq);
+
+    if (command == CHIP8_COMMAND_QUIT) {
+      break;
+    }
+  }
+
+  std::destroy_at(&core(shm));
+  munmap(memory, SEGMENT_SIZE);
+  shm_unlink(name);
+
+  return 0;
+}
+
+chip8_shm *chip8_shm_attach(const char *name) {
+  const int fd = shm_open(name, O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) < 0 || static_cast<std::size_t>(info.st_size) <
+                                  sizeof(chip8_shm)) {
+    close(fd);
+    return nullptr;
+  }
+
+  const auto size = static_cast<std::size_t>(info.st_size);
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+
+  auto *shm = static_cast<chip8_shm *>(memory);
+  if (doorbell(shm->magic).load(std::memory_order_acquire) !=
+          CHIP8_SHM_MAGIC ||
+      shm->version != CHIP8_SHM_VERSION || shm->segment_size != size) {
+    munmap(memory, size);
+    return nullptr;
+  }
+  return shm;
+}
+
+int chip8_step(chip8_shm *shm, const uint32_t n_frames, const uint16_t keymask) {
+  shm->n_frames = n_frames;
+  shm->keymask = keymask;
+  return request(shm, CHIP8_COMMAND_STEP);
+}
+
+int chip8_reset(chip8_shm *shm) { return request(shm, CHIP8_COMMAND_RESET); }
+
+int chip8_quit(chip8_shm *shm) {
+  return shm->in_process ? CHIP8_STATUS_OK : request(shm, CHIP8_COMMAND_QUIT);
+}
+
+void chip8_close(chip8_shm *shm) {
+  if (shm->in_process) {
+    std::destroy_at(&core(shm));
+    std::free(shm);
+    return;
+  }
+  munmap(shm, shm->segment_size);
+}
+}
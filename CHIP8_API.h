@@ -0,0 +1,147 @@
+/* C interface for driving the emulator from agents and test harnesses.
+ *
+ * Every emulator lives in a segment that starts with struct chip8_shm. The
+ * core itself is constructed inside the segment, so memory, registers and
+ * framebuffer are read in place through the offsets in the header.
+ *
+ * chip8_create() makes a private segment stepped in the calling process.
+ * chip8_shm_serve() publishes one as POSIX shared memory and blocks serving
+ * requests; other processes chip8_shm_attach() to it and chip8_step() rings
+ * a futex doorbell instead of serialising anything.
+ */
+#ifndef CHIP8_API_H
+#define CHIP8_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIP8_SHM_MAGIC 0x38504843u /* "CHP8" */
+#define CHIP8_SHM_VERSION 2u
+
+/* same order as Emulator::Profile */
+enum chip8_profile {
+  CHIP8_PROFILE_MODERN = 0,
+  CHIP8_PROFILE_CHIP8 = 1,
+  CHIP8_PROFILE_SUPERCHIP = 2,
+  CHIP8_PROFILE_XOCHIP = 3,
+};
+
+enum chip8_command {
+  CHIP8_COMMAND_STEP = 0,
+  CHIP8_COMMAND_RESET = 1,
+  CHIP8_COMMAND_QUIT = 2,
+};
+
+enum chip8_status {
+  CHIP8_STATUS_OK = 0,
+  /* the program exited or faulted, see fault */
+  CHIP8_STATUS_HALTED = 1,
+  CHIP8_STATUS_ERROR = -1,
+};
+
+struct chip8_shm {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t segment_size;
+
+  /* doorbells, both futex words: the agent increments request_seq, the
+   * emulator answers by setting response_seq to the same value */
+  uint32_t request_seq;
+  uint32_t response_seq;
+  /* busy-wait this many iterations before sleeping on a doorbell */
+  uint32_t spin_iterations;
+  /* nonzero if stepped in the owning process rather than served */
+  uint32_t in_process;
+
+  /* request */
+  uint32_t command;
+  uint32_t n_frames;
+  uint16_t keymask;
+  uint16_t reserved;
+  uint32_t profile;
+
+  /* response */
+  int32_t status;
+  uint32_t fault;
+  uint64_t cycle;
+  uint64_t frame;
+  /* cycle the next 60 Hz timer tick is due at, so frames run 6 or 7
+   * instructions and average PROCESSOR_SPEED / 60 like --headless */
+  double next_tick;
+  uint32_t program_counter;
+  uint32_t index_register;
+  uint8_t delay_timer;
+  uint8_t sound_timer;
+  uint8_t hires;
+  uint8_t plane_count;
+  uint16_t width;
+  uint16_t height;
+
+  /* live views into the core, relative to the start of the segment */
+  uint32_t memory_offset;
+  uint32_t memory_size;
+  uint32_t registers_offset; /* V0..VF */
+  /* plane_count planes of 64 rows, each row an unsigned 128 bit integer in
+   * native byte order with the leftmost pixel in bit 127 */
+  uint32_t framebuffer_offset;
+  uint32_t framebuffer_row_stride;
+  uint32_t framebuffer_plane_stride;
+
+  /* the ROM, kept for CHIP8_COMMAND_RESET */
+  uint32_t rom_offset;
+  uint32_t rom_size;
+  uint32_t core_offset;
+};
+
+/* private segment running in this process, NULL on failure */
+struct chip8_shm *chip8_create(int profile, const uint8_t *rom,
+                               size_t rom_size);
+
+/* creates the shared memory object `name` (e.g. "/chip8-0"), loads the ROM
+ * and serves requests until CHIP8_COMMAND_QUIT, returns 0 on a clean exit */
+int chip8_shm_serve(const char *name, int profile, const char *rom_path);
+
+/* maps a segment published by chip8_shm_serve, NULL on failure */
+struct chip8_shm *chip8_shm_attach(const char *name);
+
+/* sets the keypad to keymask and runs n_frames 60 Hz frames */
+int chip8_step(struct chip8_shm *shm, uint32_t n_frames, uint16_t keymask);
+
+/* reloads the ROM into a freshly constructed core */
+int chip8_reset(struct chip8_shm *shm);
+
+/* stops a served emulator, the segment stays mapped until chip8_close */
+int chip8_quit(struct chip8_shm *shm);
+
+void chip8_close(struct chip8_shm *shm);
+
+static inline const uint8_t *chip8_memory(const struct chip8_shm *shm) {
+  return (const uint8_t *)shm + shm->memory_offset;
+}
+
+static inline const uint8_t *chip8_registers(const struct chip8_shm *shm) {
+  return (const uint8_t *)shm + shm->registers_offset;
+}
+
+static inline int chip8_pixel(const struct chip8_shm *shm, unsigned plane,
+                              unsigned x, unsigned y) {
+  const uint8_t *row = (const uint8_t *)shm + shm->framebuffer_offset +
+                       plane * shm->framebuffer_plane_stride +
+                       y * shm->framebuffer_row_stride;
+  const unsigned bit = 127 - x;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return (row[15 - bit / 8] >> (bit % 8)) & 1;
+#else
+  return (row[bit / 8] >> (bit % 8)) & 1;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHIP8_API_H */
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Capture.hpp"
+#include "Hash.hpp"
+
+// RLE file layout, all integers little endian:
+//   "CH8F", u8 version (1), u8 frame rate, u16 width, u16 height, u8 planes
+// then per run of identical frames:
+//   u32 repeat, u64 cycle, u8 hires, u16 payload bytes, payload
+// where the payload run-length encodes the planes as (count, byte) pairs,
+// plane after plane, HEIGHT rows of WIDTH / 8 bytes, leftmost pixel in the
+// most significant bit
+
+namespace Capture {
+namespace {
+using Row = Emulator::Display::Row;
+
+constexpr std::size_t ROW_BYTES = WIDTH / 8;
+
+struct Color {
+  uint8_t r, g, b;
+};
+
+// the default palette of the SDL window, indexed by the lit planes of a pixel
+constexpr std::array<Color, 4> palette = {
+    {{0, 0, 0}, {255, 255, 255}, {170, 170, 170}, {85, 85, 85}}};
+
+struct YUV {
+  uint8_t y, u, v;
+};
+
+// full range BT.601
+constexpr auto yuv_palette = [] {
+  std::array<YUV, palette.size()> table{};
+  for (std::size_t i = 0; i < palette.size(); ++i) {
+    const double r = palette[i].r, g = palette[i].g, b = palette[i].b;
+    const auto y = 0.299 * r + 0.587 * g + 0.114 * b;
+    table[i] = {static_cast<uint8_t>(y + 0.5),
+                static_cast<uint8_t>(128.5 + (b - y) * 0.564),
+                static_cast<uint8_t>(128.5 + (r - y) * 0.713)};
+  }
+  return table;
+}();
+
+uint64_t hash(const Frame &frame) {
+  Emulator::Fnv1a hash;
+  hash.add_word(frame.hires);
+  for (const auto &plane : frame.planes) {
+    for (const auto row : plane) {
+      hash.add_row(row);
+    }
+  }
+  return hash.value();
+}
+
+bool same_picture(const Frame &a, const Frame &b) {
+  return a.hires == b.hires && a.planes == b.planes;
+}
+
+// palette index of every output pixel, lores frames are scaled 2x
+void expand(const Frame &frame, std::array<uint8_t, PIXELS> &pixels) {
+  const std::size_t scale = frame.hires ? 1 : 2;
+  for (std::size_t y = 0; y < HEIGHT; ++y) {
+    for (std::size_t x = 0; x < WIDTH; ++x) {
+      const auto bit = WIDTH - 1 - x / scale;
+      uint8_t index = 0;
+      for (std::size_t plane = 0; plane < frame.planes.size(); ++plane) {
+        const auto row = frame.planes[plane][y / scale];
+        index |= static_cast<uint8_t>(((row >> bit) & 1) << plane);
+      }
+      pixels[y * WIDTH + x] = index;
+    }
+  }
+}
+
+// (count, byte) pairs over the big-endian bytes of every row
+void run_length_encode(const Frame &frame, std::vector<uint8_t> &out) {
+  out.clear();
+  uint8_t current = 0;
+  uint8_t count = 0;
+
+  for (const auto &plane : frame.planes) {
+    for (const auto row : plane) {
+      for (std::size_t i = 0; i < ROW_BYTES; ++i) {
+        const auto byte =
+            static_cast<uint8_t>(row >> ((ROW_BYTES - 1 - i) * 8));
+        if (count > 0 && (byte != current || count == 255)) {
+          out.push_back(count);
+          out.push_back(current);
+          count = 0;
+        }
+        current = byte;
+        ++count;
+      }
+    }
+  }
+  out.push_back(count);
+  out.push_back(current);
+}
+
+template <typename VALUE_T>
+void write_le(std::ofstream &file, const VALUE_T value) {
+  for (std::size_t i = 0; i < sizeof(VALUE_T); ++i) {
+    file.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+} // namespace
+
+std::optional<Format> format_from_filename(std::string_view filename) {
+  if (filename.ends_with(".y4m")) {
+    return Format::Y4M;
+  }
+  if (filename.ends_with(".rgba")) {
+    return Format::RGBA;
+  }
+  if (filename.ends_with(".rle")) {
+    return Format::RLE;
+  }
+  return std::nullopt;
+}
+
+Writer::Writer(std::string_view filename, const Format format)
+    : m_file(filename.data(), std::ios::binary), m_format(format) {
+  if (!m_file.is_open()) {
+    return;
+  }
+  write_header();
+  m_encoder = std::thread(&Writer::encode, this);
+}
+
+Writer::~Writer() {
+  if (m_frames > 0) {
+    push(m_pending);
+  }
+  m_done.store(true, std::memory_order_release);
+  if (m_encoder.joinable()) {
+    m_encoder.join();
+  }
+}
+
+void Writer::submit(const Emulator::Display &display, const uint64_t cycle) {
+  Frame frame;
+  frame.hires = display.hires();
+  frame.cycle = cycle;
+  frame.repeat = 1;
+  for (std::size_t plane = 0; plane < frame.planes.size(); ++plane) {
+    for (std::size_t y = 0; y < HEIGHT; ++y) {
+      frame.planes[plane][y] = display.row(plane, y);
+    }
+  }
+
+  const auto frame_hash = hash(frame);
+  ++m_frames;
+
+  // extend the current run, the compare only runs on a hash match
+  if (m_frames > 1 && frame_hash == m_pending_hash &&
+      same_picture(frame, m_pending)) {
+    ++m_pending.repeat;
+    return;
+  }
+
+  if (m_frames > 1) {
+    push(m_pending);
+  }
+  m_pending = frame;
+  m_pending_hash = frame_hash;
+  ++m_unique_frames;
+}
+
+void Writer::push(const Frame &frame) {
+  if (!is_open()) {
+    return;
+  }
+  // the queue is bounded, wait for the encoder rather than drop evidence
+  while (!m_queue.push(frame)) {
+    std::this_thread::yield();
+  }
+}
+
+void Writer::encode() {
+  using namespace std::chrono_literals;
+
+  for (;;) {
+    const auto *frame = m_queue.front();
+    if (frame == nullptr) {
+      if (m_done.load(std::memory_order_acquire) && m_queue.size() == 0) {
+        break;
+      }
+      std::this_thread::sleep_for(100us);
+      continue;
+    }
+    write_frame(*frame);
+    m_queue.pop();
+  }
+  m_file.flush();
+}
+
+void Writer::write_header() {
+  switch (m_format) {
+  case Format::Y4M: {
+    const auto header = std::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C444\n",
+                                    WIDTH, HEIGHT, FRAME_RATE);
+    m_file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    break;
+  }
+  case Format::RGBA:
+    break;
+  case Format::RLE:
+    m_file.write("CH8F", 4);
+    write_le(m_file, uint8_t{1});
+    write_le(m_file, static_cast<uint8_t>(FRAME_RATE));
+    write_le(m_file, static_cast<uint16_t>(WIDTH));
+    write_le(m_file, static_cast<uint16_t>(HEIGHT));
+    write_le(m_file, static_cast<uint8_t>(Emulator::Display::PLANES));
+    break;
+  }
+}
+
+void Writer::write_frame(const Frame &frame) {
+  switch (m_format) {
+  case Format::Y4M: {
+    expand(frame, m_pixels);
+    m_encoded.resize(6 + PIXELS * 3);
+    std::memcpy(m_encoded.data(), "FRAME\n", 6);
+    auto *y = m_encoded.data() + 6;
+    auto *u = y + PIXELS;
+    auto *v = u + PIXELS;
+    for (std::size_t i = 0; i < PIXELS; ++i) {
+      const auto color = yuv_palette[m_pixels[i]];
+      y[i] = color.y;
+      u[i] = color.u;
+      v[i] = color.v;
+    }
+    break;
+  }
+  case Format::RGBA:
+    expand(frame, m_pixels);
+    m_encoded.resize(PIXELS * 4);
+    for (std::size_t i = 0; i < PIXELS; ++i) {
+      const auto color = palette[m_pixels[i]];
+      m_encoded[i * 4] = color.r;
+      m_encoded[i * 4 + 1] = color.g;
+      m_encoded[i * 4 + 2] = color.b;
+      m_encoded[i * 4 + 3] = 255;
+    }
+    break;
+  case Format::RLE:
+    // one record per run, the repeat count replaces the duplicates
+    run_length_encode(frame, m_encoded);
+    write_le(m_file, frame.repeat);
+    write_le(m_file, frame.cycle);
+    write_le(m_file, static_cast<uint8_t>(frame.hires));
+    write_le(m_file, static_cast<uint16_t>(m_encoded.size()));
+    m_file.write(reinterpret_cast<const char *>(m_encoded.data()),
+                 static_cast<std::streamsize>(m_encoded.size()));
+    return;
+  }
+
+  // fixed frame rate formats encode a run once and write it repeat times
+  for (uint32_t i = 0; i < frame.repeat; ++i) {
+    m_file.write(reinterpret_cast<const char *>(m_encoded.data()),
+                 static_cast<std::streamsize>(m_encoded.size()));
+  }
+}
+} // namespace Capture
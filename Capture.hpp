@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "Display.hpp"
+#include "SPSCQueue.hpp"
+
+namespace Capture {
+constexpr unsigned FRAME_RATE = 60;
+constexpr std::size_t QUEUE_SIZE = 64;
+// every format is written at the hires resolution, lores pixels are doubled
+constexpr std::size_t WIDTH = Emulator::Display::MAX_WIDTH;
+constexpr std::size_t HEIGHT = Emulator::Display::MAX_HEIGHT;
+constexpr std::size_t PIXELS = WIDTH * HEIGHT;
+
+enum class Format : uint8_t {
+  // YUV4MPEG2, 4:4:4, plays in ffmpeg/mpv
+  Y4M,
+  // WIDTH * HEIGHT RGBA pixels per frame, nothing else
+  RGBA,
+  // "CH8F" header, then one record per run of identical frames, see
+  // Capture.cpp
+  RLE,
+};
+
+// picked from the extension: .y4m, .rgba or .rle
+std::optional<Format> format_from_filename(std::string_view filename);
+
+// the bit-packed display planes plus how many ticks in a row they stayed
+struct Frame {
+  using Plane = std::array<Emulator::Display::Row, HEIGHT>;
+
+  std::array<Plane, Emulator::Display::PLANES> planes;
+  uint64_t cycle;
+  uint32_t repeat;
+  bool hires;
+};
+
+// Snapshots the display once per 60 Hz tick and hands the frames to a
+// background thread that encodes and writes them, so the emulator thread only
+// copies 2 KB per frame. Identical consecutive frames are collapsed by hash
+// before they are queued.
+class Writer {
+public:
+  Writer(std::string_view filename, Format format);
+
+  Writer(Writer &) = delete;
+  Writer(Writer &&) = delete;
+
+  // flushes the last run and waits for the encoder to finish
+  ~Writer();
+
+  bool is_open() const { return m_file.is_open(); }
+
+  void submit(const Emulator::Display &display, uint64_t cycle);
+
+  uint64_t frames() const { return m_frames; }
+  uint64_t unique_frames() const { return m_unique_frames; }
+
+private:
+  void push(const Frame &frame);
+  void encode();
+  void write_header();
+  void write_frame(const Frame &frame);
+
+  std::ofstream m_file;
+  Format m_format;
+  SPSCQueue<Frame, QUEUE_SIZE> m_queue;
+  Frame m_pending{};
+  uint64_t m_pending_hash{};
+  uint64_t m_frames{};
+  uint64_t m_unique_frames{};
+  // scratch buffers, only touched by the encoder thread
+  std::array<uint8_t, PIXELS> m_pixels{};
+  std::vector<uint8_t> m_encoded;
+  std::atomic<bool> m_done{};
+  std::thread m_encoder;
+};
+} // namespace Capture
@@ -0,0 +1,596 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "CHIP8.hpp"
+#include "config.hpp"
+
+namespace Emulator {
+// why Debugger::step() returned control
+enum class Stop : uint8_t {
+  None,
+  Halted,
+  Breakpoint,
+  Watchpoint,
+  Condition,
+  Step,
+};
+
+// inclusive address range, trapped before an instruction touches it
+struct Watchpoint {
+  std::size_t begin;
+  std::size_t end;
+  bool read;
+  bool write;
+};
+
+// register breakpoint like V3==5, trapped when it turns true
+struct Condition {
+  // 0x0-0xF are V0-VF
+  static constexpr uint8_t INDEX_REGISTER = 0x10;
+  static constexpr uint8_t DELAY_TIMER = 0x11;
+  static constexpr uint8_t SOUND_TIMER = 0x12;
+
+  enum class Comparison : uint8_t { Equal, NotEqual, Less, Greater };
+
+  uint8_t reg;
+  Comparison comparison;
+  std::size_t value;
+};
+
+// decimal or 0x prefixed hex
+inline std::optional<std::size_t> parse_number(std::string_view text) {
+  int base = 10;
+  if (text.starts_with("0x") || text.starts_with("0X")) {
+    text.remove_prefix(2);
+    base = 16;
+  }
+  std::size_t value{};
+  const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value, base);
+  if (text.empty() || error != std::errc{} || end != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// 0x300, 0x300-0x30f, optionally followed by :r, :w or :rw (the default)
+inline std::optional<Watchpoint> parse_watchpoint(std::string_view text) {
+  Watchpoint watchpoint{0, 0, true, true};
+
+  if (const auto colon = text.find(':'); colon != std::string_view::npos) {
+    const auto access = text.substr(colon + 1);
+    if (access != "r" && access != "w" && access != "rw") {
+      return std::nullopt;
+    }
+    watchpoint.read = access.find('r') != std::string_view::npos;
+    watchpoint.write = access.find('w') != std::string_view::npos;
+    text = text.substr(0, colon);
+  }
+
+  const auto dash = text.find('-');
+  const auto begin = parse_number(text.substr(0, dash));
+  const auto end = dash == std::string_view::npos
+                       ? begin
+                       : parse_number(text.substr(dash + 1));
+  if (!begin.has_value() || !end.has_value() || end.value() < begin.value()) {
+    return std::nullopt;
+  }
+  watchpoint.begin = begin.value();
+  watchpoint.end = end.value();
+  return watchpoint;
+}
+
+// VX, I, DT or ST followed by ==, !=, < or > and a number
+inline std::optional<Condition> parse_condition(std::string_view text) {
+  Condition condition{};
+
+  if (text.starts_with("DT")) {
+    condition.reg = Condition::DELAY_TIMER;
+    text.remove_prefix(2);
+  } else if (text.starts_with("ST")) {
+    condition.reg = Condition::SOUND_TIMER;
+    text.remove_prefix(2);
+  } else if (text.starts_with("I")) {
+    condition.reg = Condition::INDEX_REGISTER;
+    text.remove_prefix(1);
+  } else if (text.size() >= 2 && (text[0] == 'V' || text[0] == 'v')) {
+    const auto [end, error] =
+        std::from_chars(text.data() + 1, text.data() + 2, condition.reg, 16);
+    if (error != std::errc{}) {
+      return std::nullopt;
+    }
+    text.remove_prefix(2);
+  } else {
+    return std::nullopt;
+  }
+
+  constexpr std::array<std::pair<std::string_view, Condition::Comparison>, 4>
+      operators = {{{"==", Condition::Comparison::Equal},
+                    {"!=", Condition::Comparison::NotEqual},
+                    {"<", Condition::Comparison::Less},
+                    {">", Condition::Comparison::Greater}}};
+
+  for (const auto &[symbol, comparison] : operators) {
+    if (text.starts_with(symbol)) {
+      const auto value = parse_number(text.substr(symbol.size()));
+      if (!value.has_value()) {
+        return std::nullopt;
+      }
+      condition.comparison = comparison;
+      condition.value = value.value();
+      return condition;
+    }
+  }
+  return std::nullopt;
+}
+
+// Cowgod style mnemonic, long_operand is the second word of XO-CHIP F000 NNNN
+inline std::string disassemble(const Instruction instruction,
+                               const std::optional<uint16_t> long_operand = {}) {
+  const auto X = instruction.X();
+  const auto Y = instruction.Y();
+  const auto N = instruction.N();
+  const auto NN = instruction.NN();
+  const auto NNN = instruction.NNN();
+
+  switch (instruction.opcode()) {
+  case 0x0:
+    switch (instruction.value) {
+    case 0x00E0:
+      return "CLS";
+    case 0x00EE:
+      return "RET";
+    case 0x00FB:
+      return "SCR";
+    case 0x00FC:
+      return "SCL";
+    case 0x00FD:
+      return "EXIT";
+    case 0x00FE:
+      return "LOW";
+    case 0x00FF:
+      return "HIGH";
+    }
+    if (X == 0 && Y == 0xC) {
+      return std::format("SCD {}", N);
+    }
+    if (X == 0 && Y == 0xD) {
+      return std::format("SCU {}", N);
+    }
+    return std::format("SYS 0x{:03X}", NNN);
+  case 0x1:
+    return std::format("JP 0x{:03X}", NNN);
+  case 0x2:
+    return std::format("CALL 0x{:03X}", NNN);
+  case 0x3:
+    return std::format("SE V{:X}, 0x{:02X}", X, NN);
+  case 0x4:
+    return std::format("SNE V{:X}, 0x{:02X}", X, NN);
+  case 0x5:
+    if (N == 0x2) {
+      return std::format("SAVE V{:X}-V{:X}", X, Y);
+    }
+    if (N == 0x3) {
+      return std::format("LOAD V{:X}-V{:X}", X, Y);
+    }
+    return std::format("SE V{:X}, V{:X}", X, Y);
+  case 0x6:
+    return std::format("LD V{:X}, 0x{:02X}", X, NN);
+  case 0x7:
+    return std::format("ADD V{:X}, 0x{:02X}", X, NN);
+  case 0x8: {
+    constexpr std::array<std::string_view, 16> operations = {
+        "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+        "",   "",   "",    "",    "",    "",    "SHL", ""};
+    if (operations[N].empty()) {
+      break;
+    }
+    return std::format("{} V{:X}, V{:X}", operations[N], X, Y);
+  }
+  case 0x9:
+    return std::format("SNE V{:X}, V{:X}", X, Y);
+  case 0xA:
+    return std::format("LD I, 0x{:03X}", NNN);
+  case 0xB:
+    return std::format("JP V0, 0x{:03X}", NNN);
+  case 0xC:
+    return std::format("RND V{:X}, 0x{:02X}", X, NN);
+  case 0xD:
+    return std::format("DRW V{:X}, V{:X}, {}", X, Y, N);
+  case 0xE:
+    if (NN == 0x9E) {
+      return std::format("SKP V{:X}", X);
+    }
+    if (NN == 0xA1) {
+      return std::format("SKNP V{:X}", X);
+    }
+    break;
+  case 0xF:
+    switch (NN) {
+    case 0x00:
+      if (long_operand.has_value()) {
+        return std::format("LD I, 0x{:04X}", long_operand.value());
+      }
+      break;
+    case 0x01:
+      return std::format("PLANE {}", X);
+    case 0x02:
+      return "AUDIO";
+    case 0x07:
+      return std::format("LD V{:X}, DT", X);
+    case 0x0A:
+      return std::format("LD V{:X}, K", X);
+    case 0x15:
+      return std::format("LD DT, V{:X}", X);
+    case 0x18:
+      return std::format("LD ST, V{:X}", X);
+    case 0x1E:
+      return std::format("ADD I, V{:X}", X);
+    case 0x29:
+      return std::format("LD F, V{:X}", X);
+    case 0x30:
+      return std::format("LD HF, V{:X}", X);
+    case 0x33:
+      return std::format("LD B, V{:X}", X);
+    case 0x3A:
+      return std::format("PITCH V{:X}", X);
+    case 0x55:
+      return std::format("LD [I], V{:X}", X);
+    case 0x65:
+      return std::format("LD V{:X}, [I]", X);
+    case 0x75:
+      return std::format("LD R, V{:X}", X);
+    case 0x85:
+      return std::format("LD V{:X}, R", X);
+    }
+    break;
+  }
+  return std::format("DW 0x{:04X}", instruction.value);
+}
+
+// Runs an emulator one instruction at a time under breakpoints, watchpoints,
+// register conditions and step over/out. step() is patched to the cheapest
+// loop that can still trap: straight into the core while nothing is armed,
+// and with only breakpoints or step over/out one comparison per instruction,
+// since those can only trigger once the PC leaves straight-line code.
+// Watchpoints and conditions depend on every instruction and are checked on
+// each one.
+template <typename EMULATOR_T>
+class Debugger {
+public:
+  using Quirks = typename EMULATOR_T::Quirks;
+
+  explicit Debugger(EMULATOR_T &emulator) : m_emulator(emulator) {}
+
+  Debugger(Debugger &) = delete;
+  Debugger(Debugger &&) = delete;
+
+  Stop step() { return (this->*m_step)(); }
+
+  void add_breakpoint(const std::size_t address) {
+    const auto masked = address & address_mask;
+    const auto at = std::ranges::lower_bound(m_breakpoints, masked);
+    if (at == m_breakpoints.end() || *at != masked) {
+      m_breakpoints.insert(at, masked);
+    }
+    rearm();
+  }
+
+  void toggle_breakpoint(const std::size_t address) {
+    const auto masked = address & address_mask;
+    const auto at = std::ranges::lower_bound(m_breakpoints, masked);
+    if (at != m_breakpoints.end() && *at == masked) {
+      m_breakpoints.erase(at);
+    } else {
+      m_breakpoints.insert(at, masked);
+    }
+    rearm();
+  }
+
+  void add_watchpoint(const Watchpoint &watchpoint) {
+    m_watchpoints.push_back(watchpoint);
+    rearm();
+  }
+
+  void add_condition(const Condition &condition) {
+    m_conditions.push_back(condition);
+    m_conditions_held.push_back(holds(condition));
+    rearm();
+  }
+
+  // continue after a stop without trapping on the current instruction again
+  void resume() { start(Mode::Run); }
+
+  void step_into() { start(Mode::StepInto); }
+
+  // runs a CALL until it returns, otherwise the same as step_into
+  void step_over() {
+    const auto &state = m_emulator.state();
+    if (Instruction(state.memory, state.program_counter).opcode() != 0x2) {
+      start(Mode::StepInto);
+      return;
+    }
+    m_target = (state.program_counter + 2) & address_mask;
+    m_depth = state.stack.size();
+    start(Mode::StepOver);
+  }
+
+  // runs until the current subroutine returns, false without running
+  // anything outside of one
+  bool step_out() {
+    m_depth = m_emulator.state().stack.size();
+    if (m_depth == 0) {
+      m_message = "Not in a subroutine";
+      return false;
+    }
+    start(Mode::StepOut);
+    return true;
+  }
+
+  // description of the last stop
+  const std::string &message() const { return m_message; }
+
+  // count instructions from address, '>' marks the PC and '*' breakpoints
+  std::vector<std::string> listing(std::size_t address,
+                                   const std::size_t count) const {
+    const auto &state = m_emulator.state();
+    std::vector<std::string> lines;
+
+    for (std::size_t i = 0; i < count; ++i) {
+      address &= address_mask;
+      const auto instruction = Instruction(state.memory, address);
+      const bool long_instruction = Quirks::xochip && instruction.value == 0xF000;
+      const auto text = disassemble(
+          instruction, long_instruction ? std::optional(Instruction(
+                                              state.memory, address + 2).value)
+                                        : std::nullopt);
+
+      lines.push_back(std::format(
+          "{}{} {:03X}  {:04X}  {}",
+          address == state.program_counter ? '>' : ' ',
+          std::ranges::binary_search(m_breakpoints, address) ? '*' : ' ',
+          address, instruction.value, text));
+      address += long_instruction ? 4 : 2;
+    }
+    return lines;
+  }
+
+private:
+  static constexpr std::size_t address_mask = Quirks::memory_size - 1;
+  static constexpr std::size_t NO_BREAKPOINT = Quirks::memory_size;
+
+  enum class Mode : uint8_t { Run, StepInto, StepOver, StepOut };
+
+  struct MemoryAccess {
+    std::size_t address;
+    std::size_t length;
+    bool write;
+  };
+
+  void start(const Mode mode) {
+    m_mode = mode;
+    m_resuming = true;
+    rearm();
+  }
+
+  // swaps the step entry point, called whenever something is (dis)armed
+  void rearm() {
+    m_next_breakpoint =
+        next_breakpoint(m_emulator.state().program_counter & address_mask);
+    if (!m_watchpoints.empty() || !m_conditions.empty() ||
+        m_mode == Mode::StepInto) {
+      m_step = &Debugger::checked_step<true>;
+    } else if (!m_breakpoints.empty() || m_mode != Mode::Run) {
+      m_step = &Debugger::checked_step<false>;
+    } else {
+      m_step = &Debugger::fast_step;
+    }
+  }
+
+  // the first breakpoint at or after address
+  std::size_t next_breakpoint(const std::size_t address) const {
+    const auto at = std::ranges::lower_bound(m_breakpoints, address);
+    return at == m_breakpoints.end() ? NO_BREAKPOINT : *at;
+  }
+
+  Stop fast_step() {
+    return m_emulator.single_step() ? Stop::None : Stop::Halted;
+  }
+
+  // While the PC runs straight through a block it only moves up, so the next
+  // breakpoint ahead of it is looked up once when a block is entered and
+  // every instruction compares against it. A breakpoint the PC steps over,
+  // like an odd address, is replaced by the next one. Step over and step out
+  // can only finish on a RET, which leaves the block too.
+  template <bool EVERY_INSTRUCTION> Stop checked_step() {
+    const auto &state = m_emulator.state();
+    const auto address = state.program_counter & address_mask;
+
+    if (address > m_next_breakpoint) {
+      m_next_breakpoint = next_breakpoint(address);
+    }
+    if (address == m_next_breakpoint) {
+      if (!m_resuming) {
+        return stop(Stop::Breakpoint,
+                    std::format("Breakpoint at 0x{:03X}", address));
+      }
+      m_next_breakpoint = next_breakpoint(address + 1);
+    }
+    if constexpr (EVERY_INSTRUCTION) {
+      if (!m_resuming) {
+        if (const auto watched =
+                watched_address(Instruction(state.memory, address))) {
+          return stop(Stop::Watchpoint,
+                      std::format("Watchpoint on 0x{:03X} at 0x{:03X}",
+                                  watched.value(), address));
+        }
+      }
+    }
+
+    if (!m_emulator.single_step()) {
+      return stop(Stop::Halted, std::format("Halted at 0x{:03X}", address));
+    }
+    const auto next = state.program_counter & address_mask;
+    // FX0A and the display wait retry in place, don't trap them again
+    m_resuming = next == address;
+
+    if constexpr (EVERY_INSTRUCTION) {
+      std::optional<std::size_t> triggered;
+      for (std::size_t i = 0; i < m_conditions.size(); ++i) {
+        const bool held = holds(m_conditions[i]);
+        if (held && !m_conditions_held[i] && !triggered.has_value()) {
+          triggered = i;
+        }
+        m_conditions_held[i] = held;
+      }
+      if (triggered.has_value()) {
+        return stop(Stop::Condition,
+                    std::format("Condition #{} after 0x{:03X}",
+                                triggered.value() + 1, address));
+      }
+      if (m_mode == Mode::StepInto) {
+        return stop(Stop::Step, std::format("Stepped to 0x{:03X}", next));
+      }
+    }
+
+    if (next == address + 2) {
+      return Stop::None;
+    }
+
+    // jumped, skipped, called, returned, retried or wrapped around: a new
+    // block
+    m_next_breakpoint = next_breakpoint(next);
+    const auto depth = state.stack.size();
+    const bool stepped =
+        (m_mode == Mode::StepOver && depth == m_depth && next == m_target) ||
+        (m_mode == Mode::StepOut && depth < m_depth);
+    if (stepped) {
+      return stop(Stop::Step, std::format("Stepped to 0x{:03X}", next));
+    }
+    return Stop::None;
+  }
+
+  Stop stop(const Stop reason, std::string &&message) {
+    m_message = std::move(message);
+    m_mode = Mode::Run;
+    rearm();
+    return reason;
+  }
+
+  bool holds(const Condition &condition) const {
+    const auto &state = m_emulator.state();
+    std::size_t value{};
+    switch (condition.reg) {
+    case Condition::INDEX_REGISTER:
+      value = state.index_register;
+      break;
+    case Condition::DELAY_TIMER:
+      value = state.delay_timer;
+      break;
+    case Condition::SOUND_TIMER:
+      value = state.sound_timer;
+      break;
+    default:
+      value = state.registers[condition.reg & 0xF];
+      break;
+    }
+
+    switch (condition.comparison) {
+    case Condition::Comparison::Equal:
+      return value == condition.value;
+    case Condition::Comparison::NotEqual:
+      return value != condition.value;
+    case Condition::Comparison::Less:
+      return value < condition.value;
+    case Condition::Comparison::Greater:
+      return value > condition.value;
+    }
+    return false;
+  }
+
+  // the memory an instruction is about to read or write through I
+  std::optional<MemoryAccess> memory_access(const Instruction instruction) const {
+    const auto &state = m_emulator.state();
+    const auto index = state.index_register;
+    const std::size_t X = instruction.X();
+
+    switch (instruction.opcode()) {
+    case 0x5:
+      if (Quirks::xochip && (instruction.N() == 0x2 || instruction.N() == 0x3)) {
+        const std::size_t Y = instruction.Y();
+        return MemoryAccess{index, (X <= Y ? Y - X : X - Y) + 1,
+                            instruction.N() == 0x2};
+      }
+      break;
+    case 0xD: {
+      const bool large = Quirks::schip && instruction.N() == 0;
+      const std::size_t bytes = large ? 32 : instruction.N();
+      return MemoryAccess{
+          index, bytes * static_cast<std::size_t>(std::popcount(state.plane_mask)),
+          false};
+    }
+    case 0xF:
+      switch (instruction.NN()) {
+      case 0x02:
+        if (Quirks::xochip && X == 0) {
+          return MemoryAccess{index, AUDIO_PATTERN_SIZE, false};
+        }
+        break;
+      case 0x33:
+        return MemoryAccess{index, 3, true};
+      case 0x55:
+        return MemoryAccess{index, X + 1, true};
+      case 0x65:
+        return MemoryAccess{index, X + 1, false};
+      }
+      break;
+    }
+    return std::nullopt;
+  }
+
+  std::optional<std::size_t> watched_address(const Instruction instruction) const {
+    const auto access = memory_access(instruction);
+    if (!access.has_value()) {
+      return std::nullopt;
+    }
+
+    for (std::size_t i = 0; i < access->length; ++i) {
+      const auto address = (access->address + i) & address_mask;
+      for (const auto &watchpoint : m_watchpoints) {
+        if (address >= watchpoint.begin && address <= watchpoint.end &&
+            (access->write ? watchpoint.write : watchpoint.read)) {
+          return address;
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+  EMULATOR_T &m_emulator;
+  Stop (Debugger::*m_step)() = &Debugger::fast_step;
+  // sorted
+  std::vector<std::size_t> m_breakpoints;
+  std::size_t m_next_breakpoint{NO_BREAKPOINT};
+  std::vector<Watchpoint> m_watchpoints;
+  std::vector<Condition> m_conditions;
+  std::vector<bool> m_conditions_held;
+  std::string m_message;
+  std::size_t m_target{};
+  std::size_t m_depth{};
+  Mode m_mode{Mode::Run};
+  // set after a stop so resuming executes the trapped instruction
+  bool m_resuming{};
+};
+} // namespace Emulator
@@ -0,0 +1,144 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "config.hpp"
+
+namespace Emulator {
+// bit-packed framebuffer with one 128 bit word per line and plane, leftmost
+// pixel in the most significant bit. lores mode uses the top-left 64x32
+// corner, so scrolls and sprite blits are whole-row shifts and xors in both
+// modes
+class Display {
+public:
+  __extension__ typedef unsigned __int128 Row;
+
+  static constexpr std::size_t MAX_WIDTH = 128;
+  static constexpr std::size_t MAX_HEIGHT = 64;
+  static constexpr std::size_t PLANES = 2;
+  static constexpr uint8_t ALL_PLANES = (1 << PLANES) - 1;
+
+  bool hires() const { return m_hires; }
+
+  void set_hires(const bool hires) {
+    m_hires = hires;
+    clear(ALL_PLANES);
+  }
+
+  std::size_t width() const { return m_hires ? MAX_WIDTH : WIDTH; }
+  std::size_t height() const { return m_hires ? MAX_HEIGHT : HEIGHT; }
+
+  void clear(const uint8_t plane_mask) {
+    for (std::size_t plane = 0; plane < PLANES; ++plane) {
+      if (plane_mask & (1 << plane)) {
+        m_planes[plane].fill(0);
+      }
+    }
+  }
+
+  // xors a sprite of up to 16 pixels per row onto a plane, returns whether
+  // any lit pixel got erased
+  template <bool WRAP>
+  bool draw(const std::size_t plane, const std::size_t x, const std::size_t y,
+            std::span<const uint16_t> sprite, const std::size_t sprite_width) {
+    const auto visible = row_mask();
+    bool collision = false;
+
+    for (std::size_t i = 0; i < sprite.size(); ++i) {
+      auto line = y + i;
+      if (line >= height()) {
+        if constexpr (!WRAP) {
+          break;
+        }
+        line -= height();
+      }
+
+      const auto sprite_row = static_cast<Row>(sprite[i])
+                              << (MAX_WIDTH - sprite_width);
+      auto bits = (sprite_row >> x) & visible;
+      if constexpr (WRAP) {
+        if (x + sprite_width > width()) {
+          bits |= (sprite_row << (width() - x)) & visible;
+        }
+      }
+
+      auto &row = m_planes[plane][line];
+      collision |= (row & bits) != 0;
+      row ^= bits;
+    }
+
+    return collision;
+  }
+
+  void scroll_down(std::size_t lines, const uint8_t plane_mask) {
+    lines = std::min(lines, height());
+    for_planes(plane_mask, [&](auto &rows) {
+      const auto end = std::next(rows.begin(), static_cast<long>(height()));
+      std::move_backward(rows.begin(), std::prev(end, static_cast<long>(lines)),
+                         end);
+      std::fill_n(rows.begin(), lines, 0);
+    });
+  }
+
+  void scroll_up(std::size_t lines, const uint8_t plane_mask) {
+    lines = std::min(lines, height());
+    for_planes(plane_mask, [&](auto &rows) {
+      const auto end = std::next(rows.begin(), static_cast<long>(height()));
+      std::move(std::next(rows.begin(), static_cast<long>(lines)), end,
+                rows.begin());
+      std::fill(std::prev(end, static_cast<long>(lines)), end, 0);
+    });
+  }
+
+  void scroll_left(const std::size_t pixels, const uint8_t plane_mask) {
+    const auto visible = row_mask();
+    for_planes(plane_mask, [&](auto &rows) {
+      for (auto &row : rows) {
+        row = (row << pixels) & visible;
+      }
+    });
+  }
+
+  void scroll_right(const std::size_t pixels, const uint8_t plane_mask) {
+    const auto visible = row_mask();
+    for_planes(plane_mask, [&](auto &rows) {
+      for (auto &row : rows) {
+        row = (row >> pixels) & visible;
+      }
+    });
+  }
+
+  // bit n of the result is set if the pixel is lit on plane n
+  uint8_t pixel(const std::size_t x, const std::size_t y) const {
+    uint8_t value = 0;
+    for (std::size_t plane = 0; plane < PLANES; ++plane) {
+      const auto bit = (m_planes[plane][y] >> (MAX_WIDTH - 1 - x)) & 1;
+      value |= static_cast<uint8_t>(bit << plane);
+    }
+    return value;
+  }
+
+  const Row &row(const std::size_t plane, const std::size_t y) const {
+    return m_planes[plane][y];
+  }
+
+private:
+  Row row_mask() const {
+    return m_hires ? ~Row{0} : ~Row{0} << (MAX_WIDTH - WIDTH);
+  }
+
+  void for_planes(const uint8_t plane_mask, auto &&function) {
+    for (std::size_t plane = 0; plane < PLANES; ++plane) {
+      if (plane_mask & (1 << plane)) {
+        function(m_planes[plane]);
+      }
+    }
+  }
+
+  std::array<std::array<Row, MAX_HEIGHT>, PLANES> m_planes{};
+  bool m_hires{false};
+};
+} // namespace Emulator
@@ -0,0 +1,353 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "CHIP8.hpp"
+#include "Hash.hpp"
+#include "config.hpp"
+
+namespace Emulator {
+// FNV-1a over registers, PC, I, timers, stack and the framebuffer, about as
+// cheap as a handful of instructions, what Lockstep compares every interval
+inline uint64_t state_hash(const auto &emulator) {
+  Fnv1a hash;
+  const auto mix = [&hash](const uint64_t word) { hash.add_word(word); };
+
+  const auto &state = emulator.state();
+  mix(state.program_counter);
+  mix(state.index_register);
+  mix(static_cast<uint64_t>(state.delay_timer << 8 | state.sound_timer));
+  mix(static_cast<uint64_t>(state.fault));
+  for (const auto reg : state.registers) {
+    mix(reg);
+  }
+  mix(state.stack.size());
+  for (const auto address : state.stack.entries()) {
+    mix(address);
+  }
+
+  const auto &display = emulator.display();
+  mix(display.hires());
+  for (std::size_t plane = 0; plane < Display::PLANES; ++plane) {
+    for (std::size_t y = 0; y < Display::MAX_HEIGHT; ++y) {
+      hash.add_row(display.row(plane, y));
+    }
+  }
+  return hash.value();
+}
+
+// FNV-1a over memory, 8 bytes at a time with all-zero words skipped so a
+// 4 KB and a 64 KB core with the same contents hash the same. Up to 8192
+// words, so only checked at checkpoints and while bisecting.
+inline uint64_t memory_hash(const auto &emulator) {
+  Fnv1a hash;
+  const auto &memory = emulator.state().memory;
+  for (std::size_t i = 0; i < memory.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, memory.data() + i, sizeof(word));
+    if (word != 0) {
+      hash.add_word(i);
+      hash.add_word(word);
+    }
+  }
+  return hash.value();
+}
+
+// both, everything a program can observe
+inline bool same_observable_state(const auto &a, const auto &b) {
+  return state_hash(a) == state_hash(b) && memory_hash(a) == memory_hash(b);
+}
+
+// where two cores first disagreed
+struct Divergence {
+  // instructions both had executed in agreement before the diverging one
+  uint64_t cycle;
+  uint32_t program_counter;
+  uint16_t opcode;
+  // what differs once it has executed, e.g. "V1 08 != 02, VF 00 != 01"
+  std::string differences;
+};
+
+// Runs a reference and a candidate core on the same ROM and inputs and
+// compares state_hash() every interval instructions, memory_hash() too at
+// checkpoints and when verifying. On a mismatch both are replayed from the
+// last checkpoint and bisected on both hashes down to the instruction after
+// which the states differ, so a memory write that diverged earlier than the
+// registers did is still found. Any two types with the CHIP8 interface work,
+// e.g. two profiles or an optimised core against the interpreter; both have
+// to be copyable for the checkpoints.
+template <typename REFERENCE_T, typename CANDIDATE_T> class Lockstep {
+public:
+  // A comparison hashes registers and framebuffer only, memory (about 1 us
+  // per 4 KB core and 6 us per 64 KB XO-CHIP one on a desktop CPU) is hashed
+  // and both cores copied only at checkpoints, every CHECKPOINT_SPACING
+  // instructions (or every interval, if longer).
+  Lockstep(REFERENCE_T &reference, CANDIDATE_T &candidate,
+           const uint64_t interval)
+      : m_reference(reference), m_candidate(candidate),
+        m_interval(std::max<uint64_t>(interval, 1)),
+        m_reference_checkpoint(reference), m_candidate_checkpoint(candidate) {
+    // different ROMs or profiles can disagree before the first instruction
+    if (!same_observable_state(m_reference, m_candidate)) {
+      m_divergence = Divergence{0, m_reference.state().program_counter,
+                                opcode(m_reference),
+                                differences(m_reference, m_candidate, true,
+                                            true)};
+    }
+  }
+
+  void set_keys(const uint16_t keys) {
+    m_events.push_back({m_steps, keys, false});
+    m_reference.set_keys(keys);
+    m_candidate.set_keys(keys);
+  }
+
+  void timer_tick() {
+    m_events.push_back({m_steps, 0, true});
+    m_reference.timer_tick();
+    m_candidate.timer_tick();
+  }
+
+  // one instruction on both cores, false once they diverged or halted
+  bool single_step() {
+    if (m_divergence.has_value() || m_halted) {
+      return false;
+    }
+
+    const auto reference_running = m_reference.single_step();
+    const auto candidate_running = m_candidate.single_step();
+    ++m_steps;
+
+    if (reference_running != candidate_running) {
+      bisect();
+      return false;
+    }
+    m_halted = !reference_running;
+
+    if (m_halted || m_steps - m_agreed == m_interval) {
+      return compare(m_halted) && !m_halted;
+    }
+    return true;
+  }
+
+  // forces a comparison of the instructions since the last one
+  bool verify() {
+    if (!m_divergence.has_value() && m_steps > m_verified) {
+      compare(true);
+    }
+    return !m_divergence.has_value();
+  }
+
+  const std::optional<Divergence> &divergence() const { return m_divergence; }
+
+  uint64_t cycle_count() const { return m_reference.cycle_count(); }
+
+  bool halted() const { return m_halted; }
+
+private:
+  // inputs between checkpoints, applied before instruction `step`
+  struct Event {
+    uint64_t step;
+    uint16_t keys;
+    bool timer_tick;
+  };
+
+  // copies of the cores are this many instructions apart at most, a
+  // mismatch replays up to this many more
+  static constexpr uint64_t CHECKPOINT_SPACING = 4096;
+
+  // bisects on a mismatch, otherwise moves the checkpoint up once it is
+  // CHECKPOINT_SPACING instructions behind. Memory is only compared before
+  // a checkpoint or with `full`.
+  bool compare(const bool full) {
+    if (state_hash(m_reference) != state_hash(m_candidate)) {
+      bisect();
+      return false;
+    }
+    m_agreed = m_steps;
+
+    const bool checkpointing = m_steps >= CHECKPOINT_SPACING;
+    if (full || checkpointing) {
+      if (memory_hash(m_reference) != memory_hash(m_candidate)) {
+        bisect();
+        return false;
+      }
+      m_verified = m_steps;
+    }
+    if (checkpointing) {
+      checkpoint();
+    }
+    return true;
+  }
+
+  static uint16_t opcode(const auto &emulator) {
+    return Instruction(emulator.state().memory,
+                       emulator.state().program_counter)
+        .value;
+  }
+
+  void checkpoint() {
+    m_reference_checkpoint = m_reference;
+    m_candidate_checkpoint = m_candidate;
+    m_checkpoint_cycle += m_steps;
+    m_steps = 0;
+    m_agreed = 0;
+    m_verified = 0;
+    m_events.clear();
+  }
+
+  // copies of both cores advanced `steps` instructions past the checkpoint
+  struct Replay {
+    REFERENCE_T reference;
+    CANDIDATE_T candidate;
+    bool reference_running{true};
+    bool candidate_running{true};
+  };
+
+  Replay replay(const uint64_t steps) const {
+    Replay replay{m_reference_checkpoint, m_candidate_checkpoint};
+    auto event = m_events.begin();
+    for (uint64_t step = 0; step < steps; ++step) {
+      for (; event != m_events.end() && event->step == step; ++event) {
+        if (event->timer_tick) {
+          replay.reference.timer_tick();
+          replay.candidate.timer_tick();
+        } else {
+          replay.reference.set_keys(event->keys);
+          replay.candidate.set_keys(event->keys);
+        }
+      }
+      replay.reference_running = replay.reference.single_step();
+      replay.candidate_running = replay.candidate.single_step();
+      if (replay.reference_running != replay.candidate_running ||
+          !replay.reference_running) {
+        break;
+      }
+    }
+    return replay;
+  }
+
+  static bool agree(const Replay &replay) {
+    return replay.reference_running == replay.candidate_running &&
+           same_observable_state(replay.reference, replay.candidate);
+  }
+
+  // the last full comparison agreed and the current state doesn't, halve
+  // the range until the one instruction in between is left
+  void bisect() {
+    uint64_t good = m_verified;
+    uint64_t bad = m_steps;
+    while (bad - good > 1) {
+      const auto middle = good + (bad - good) / 2;
+      if (agree(replay(middle))) {
+        good = middle;
+      } else {
+        bad = middle;
+      }
+    }
+
+    const auto before = replay(good);
+    const auto after = replay(bad);
+    m_divergence = Divergence{
+        m_checkpoint_cycle + good, before.reference.state().program_counter,
+        opcode(before.reference),
+        differences(after.reference, after.candidate,
+                    after.reference_running, after.candidate_running)};
+  }
+
+  static std::string differences(const auto &reference, const auto &candidate,
+                                 const bool reference_running,
+                                 const bool candidate_running) {
+    std::vector<std::string> found;
+    const auto &a = reference.state();
+    const auto &b = candidate.state();
+
+    if (reference_running != candidate_running) {
+      found.push_back(reference_running ? "candidate halted"
+                                        : "reference halted");
+    }
+    if (a.program_counter != b.program_counter) {
+      found.push_back(
+          std::format("PC {:03X} != {:03X}", a.program_counter,
+                      b.program_counter));
+    }
+    if (a.index_register != b.index_register) {
+      found.push_back(
+          std::format("I {:03X} != {:03X}", a.index_register,
+                      b.index_register));
+    }
+    for (std::size_t i = 0; i < a.registers.size(); ++i) {
+      if (a.registers[i] != b.registers[i]) {
+        found.push_back(std::format("V{:X} {:02X} != {:02X}", i,
+                                    a.registers[i], b.registers[i]));
+      }
+    }
+    if (a.delay_timer != b.delay_timer || a.sound_timer != b.sound_timer) {
+      found.push_back(std::format("timers {}/{} != {}/{}", a.delay_timer,
+                                  a.sound_timer, b.delay_timer,
+                                  b.sound_timer));
+    }
+    if (a.fault != b.fault) {
+      found.push_back(std::format("fault {} != {}",
+                                  static_cast<unsigned>(a.fault),
+                                  static_cast<unsigned>(b.fault)));
+    }
+    if (!std::ranges::equal(a.stack.entries(), b.stack.entries())) {
+      found.push_back(std::format("stack depth {} != {}", a.stack.size(),
+                                  b.stack.size()));
+    }
+
+    const auto memory_size = std::max(a.memory.size(), b.memory.size());
+    for (std::size_t address = 0; address < memory_size; ++address) {
+      const auto byte_a = address < a.memory.size() ? a.memory[address] : 0;
+      const auto byte_b = address < b.memory.size() ? b.memory[address] : 0;
+      if (byte_a != byte_b) {
+        found.push_back(std::format("memory[{:03X}] {:02X} != {:02X}", address,
+                                    byte_a, byte_b));
+        break;
+      }
+    }
+
+    const auto &display_a = reference.display();
+    const auto &display_b = candidate.display();
+    if (display_a.hires() != display_b.hires()) {
+      found.push_back("resolution");
+    }
+    for (std::size_t y = 0; y < Display::MAX_HEIGHT; ++y) {
+      if (display_a.row(0, y) != display_b.row(0, y) ||
+          display_a.row(1, y) != display_b.row(1, y)) {
+        found.push_back(std::format("framebuffer row {}", y));
+        break;
+      }
+    }
+
+    std::string text;
+    for (const auto &difference : found) {
+      text += text.empty() ? difference : ", " + difference;
+    }
+    return text;
+  }
+
+  REFERENCE_T &m_reference;
+  CANDIDATE_T &m_candidate;
+  uint64_t m_interval;
+  REFERENCE_T m_reference_checkpoint;
+  CANDIDATE_T m_candidate_checkpoint;
+  std::vector<Event> m_events;
+  // instructions since the checkpoint, at the last agreeing comparison and
+  // at the last one that agreed on memory too
+  uint64_t m_steps{};
+  uint64_t m_agreed{};
+  uint64_t m_verified{};
+  uint64_t m_checkpoint_cycle{};
+  std::optional<Divergence> m_divergence;
+  bool m_halted{};
+};
+} // namespace Emulator
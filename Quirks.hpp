@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "config.hpp"
+
+namespace Emulator {
+// instruction set extensions on top of the base CHIP-8 opcodes
+enum class Extensions : uint8_t { None, SuperChip, XOChip };
+
+// behaviours that differ between interpreters, resolved at compile time so
+// the core gets a specialised single_step for every combination
+template <bool SHIFT_VY, bool LOAD_STORE_INCREMENTS_I, bool JUMP_USES_VX,
+          bool WRAP_SPRITES, bool DISPLAY_WAIT, bool LOGIC_RESETS_VF,
+          Extensions EXTENSIONS = Extensions::None>
+struct QuirkPolicy {
+  // 8XY6/8XYE shift VY into VX instead of shifting VX in place
+  static constexpr bool shift_vy = SHIFT_VY;
+  // FX55/FX65 leave I pointing past the last register stored/loaded
+  static constexpr bool load_store_increments_i = LOAD_STORE_INCREMENTS_I;
+  // BNNN is BXNN: jump to XNN + VX instead of NNN + V0
+  static constexpr bool jump_uses_vx = JUMP_USES_VX;
+  // sprites wrap around the screen edges instead of being clipped
+  static constexpr bool wrap_sprites = WRAP_SPRITES;
+  // DXYN waits for the next 60 Hz tick before drawing
+  static constexpr bool display_wait = DISPLAY_WAIT;
+  // 8XY1/8XY2/8XY3 clear VF
+  static constexpr bool logic_resets_vf = LOGIC_RESETS_VF;
+
+  static constexpr Extensions extensions = EXTENSIONS;
+  // hires display, scrolling, 16x16 sprites, big font and RPL flags
+  static constexpr bool schip = EXTENSIONS != Extensions::None;
+  // 64 KB memory, bitplanes, long I load, register ranges and audio pattern
+  static constexpr bool xochip = EXTENSIONS == Extensions::XOChip;
+  static constexpr std::size_t memory_size =
+      xochip ? XO_MEMORY_SIZE : MEMORY_SIZE;
+};
+
+namespace Quirks {
+// what this emulator has always done
+using Modern = QuirkPolicy<false, false, false, false, false, false>;
+// COSMAC VIP interpreter
+using CHIP8 = QuirkPolicy<true, true, false, false, true, true>;
+// SUPER-CHIP 1.1 on the HP48
+using SuperChip = QuirkPolicy<false, false, true, false, false, false,
+                              Extensions::SuperChip>;
+using XOChip =
+    QuirkPolicy<true, true, false, true, false, false, Extensions::XOChip>;
+} // namespace Quirks
+
+enum class Profile : uint8_t { Modern, CHIP8, SuperChip, XOChip };
+
+constexpr std::optional<Profile> profile_from_name(std::string_view name) {
+  if (name == "modern") {
+    return Profile::Modern;
+  }
+  if (name == "chip8") {
+    return Profile::CHIP8;
+  }
+  if (name == "schip") {
+    return Profile::SuperChip;
+  }
+  if (name == "xochip") {
+    return Profile::XOChip;
+  }
+  return std::nullopt;
+}
+} // namespace Emulator
@@ -3,59 +3,51 @@
 #include <SDL.h>
 #include <SDL_blendmode.h>
 #include <SDL_keycode.h>
-#include <SDL_mixer.h>
 #include <SDL_pixels.h>
 #include <SDL_render.h>
 #include <SDL_timer.h>
-#include <SDL_ttf.h>
 #include <SDL_video.h>
+#ifdef CHIP8_TTF
+#include <SDL_ttf.h>
+#endif
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
 #include <string_view>
+#include <utility>
 
+#include "Display.hpp"
+#include "Font.hpp"
+#include "Upscaler.hpp"
 #include "config.hpp"
 
 struct Context {
   SDL_Window *window{};
   SDL_Renderer *renderer{};
+  // window sized, the display is upscaled into it on the CPU
   SDL_Texture *chip8_screen{};
-  uint32_t *pixels{};
   SDL_PixelFormat *pixel_format{};
-  Mix_Chunk *beep{};
-  TTF_Font *font;
   unsigned width;
   unsigned height;
-
-  Context(std::string_view window_name, auto window_width, auto window_height) {
+  Render::Upscaler upscaler;
+  // a TrueType font for the UI instead of the built-in one, opened the first
+  // time text is drawn
+  std::string font_path;
+
+  // only what the first frame needs, text and audio start on first use
+  Context(std::string_view window_name, auto window_width, auto window_height)
+      : upscaler(static_cast<std::size_t>(window_width),
+                 static_cast<std::size_t>(window_height)) {
     width = window_width;
     height = window_height;
 
-    auto audio_rate = 44100;
-    auto audio_format = static_cast<uint16_t>(AUDIO_S32);
-    auto audio_channels = 1;
-
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) < 0) {
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
       SDL_Log("Couldn't initialize SDL: %s\n", SDL_GetError());
       exit(1);
     }
 
-    if (TTF_Init() < 0) {
-      SDL_Log("Couldn't initialize SDL_ttf: %s\n", SDL_GetError());
-      exit(1);
-    }
-
-    if (Mix_OpenAudio(audio_rate, audio_format, audio_channels, 4096) < 0) {
-      SDL_Log("Couldn't open audio: %s\n", SDL_GetError());
-      exit(1);
-    } else {
-      Mix_QuerySpec(&audio_rate, &audio_format, &audio_channels);
-      SDL_Log("Opened audio at %d Hz %d bit%s %s", audio_rate,
-              (audio_format & 0xFF),
-              (SDL_AUDIO_ISFLOAT(audio_format) ? " (float)" : ""),
-              (audio_channels > 2)   ? "surround"
-              : (audio_channels > 1) ? "stereo"
-                                     : "mono");
-    }
-
     window = SDL_CreateWindow(window_name.data(), SDL_WINDOWPOS_UNDEFINED,
                               SDL_WINDOWPOS_UNDEFINED, window_width,
                               window_height, SDL_WINDOW_SHOWN);
@@ -66,42 +58,120 @@ struct Context {
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "best");
     SDL_RenderSetLogicalSize(renderer, window_width, window_height);
 
-    // full rgb because why not
+    // copied 1:1, software renderers would otherwise stretch it every frame
     chip8_screen = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
-                                     SDL_TEXTUREACCESS_STREAMING,
-                                     Emulator::WIDTH, Emulator::HEIGHT);
+                                     SDL_TEXTUREACCESS_STREAMING, window_width,
+                                     window_height);
     pixel_format = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
 
-    SDL_SetTextureScaleMode(chip8_screen, SDL_ScaleModeNearest);
-    SDL_SetTextureBlendMode(chip8_screen, SDL_BLENDMODE_BLEND);
-
-    std::string_view filename = "beep.wav";
-    beep = Mix_LoadWAV(filename.data());
-
-    if (beep == nullptr) {
-      SDL_Log("Couldn't load %s: %s\n", filename.data(), SDL_GetError());
-      exit(1);
-    }
-
-    const char *font_name = "/usr/share/fonts/TTF/DejaVuSans.ttf";
-    font = TTF_OpenFont(font_name, 24);
-
-    if (!font) {
-      SDL_Log("error: font '%s' not found\n", font_name);
-      exit(EXIT_FAILURE);
-    }
+    SDL_SetTextureBlendMode(chip8_screen, SDL_BLENDMODE_NONE);
   }
 
   Context(Context &) = delete;
   Context(Context &&) = delete;
 
   ~Context() {
-    SDL_DestroyRenderer(renderer);
+#ifdef CHIP8_TTF
+    if (m_font != nullptr) {
+      TTF_CloseFont(m_font);
+      TTF_Quit();
+    }
+#endif
+    SDL_DestroyTexture(m_glyphs);
     SDL_DestroyTexture(chip8_screen);
+    SDL_FreeFormat(pixel_format);
+    SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
-    Mix_FreeChunk(beep);
-    TTF_CloseFont(font);
   }
+
+#ifdef CHIP8_TTF
+  // nullptr without font_path or if it can't be opened, use glyphs() then
+  TTF_Font *font() {
+    if (m_font == nullptr && !m_font_failed && !font_path.empty()) {
+      if (TTF_Init() == 0) {
+        m_font = TTF_OpenFont(font_path.c_str(), 24);
+      }
+      if (m_font == nullptr) {
+        SDL_Log("Couldn't open font '%s', using the built-in one: %s\n",
+                font_path.c_str(), SDL_GetError());
+        m_font_failed = true;
+      }
+    }
+    return m_font;
+  }
+#endif
+
+  // the built-in font as one row of white glyphs on transparent pixels
+  SDL_Texture *glyphs() {
+    if (m_glyphs != nullptr) {
+      return m_glyphs;
+    }
+
+    constexpr auto atlas_width = Font::GLYPH_COUNT * Font::GLYPH_WIDTH;
+    std::array<uint32_t, atlas_width * Font::GLYPH_HEIGHT> pixels{};
+    const auto lit = SDL_MapRGBA(pixel_format, 255, 255, 255, 255);
+    for (std::size_t i = 0; i < Font::GLYPH_COUNT; ++i) {
+      const auto glyph = Font::glyph(static_cast<char>(Font::FIRST + i));
+      for (std::size_t y = 0; y < Font::GLYPH_HEIGHT; ++y) {
+        for (std::size_t x = 0; x < Font::GLYPH_WIDTH; ++x) {
+          if ((glyph[y] << x) & 0x80) {
+            pixels[y * atlas_width + i * Font::GLYPH_WIDTH + x] = lit;
+          }
+        }
+      }
+    }
+
+    m_glyphs = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
+                                 SDL_TEXTUREACCESS_STATIC,
+                                 static_cast<int>(atlas_width),
+                                 static_cast<int>(Font::GLYPH_HEIGHT));
+    SDL_UpdateTexture(m_glyphs, nullptr, pixels.data(),
+                      static_cast<int>(atlas_width * sizeof(uint32_t)));
+    SDL_SetTextureBlendMode(m_glyphs, SDL_BLENDMODE_BLEND);
+    return m_glyphs;
+  }
+
+private:
+#ifdef CHIP8_TTF
+  TTF_Font *m_font{};
+  bool m_font_failed{};
+#endif
+  SDL_Texture *m_glyphs{};
+};
+
+enum class Key {
+  None,
+  Exit,
+  Pause,
+  ToggleDebugger,
+  ToggleBreakpoint,
+  Continue,
+  StepInto,
+  StepOver,
+  StepOut,
 };
 
-enum class Key { None, Exit, Pause };
\ No newline at end of file
+// physical key position -> CHIP-8 keypad key, -1 if the key isn't bound
+constexpr auto keypad_lookup = [] {
+  using Emulator::Keymap;
+
+  constexpr std::array<std::pair<SDL_Scancode, Keymap>,
+                       Emulator::KEYBOARD_SIZE>
+      bindings = {{
+          {SDL_SCANCODE_1, Keymap::one}, {SDL_SCANCODE_2, Keymap::two},
+          {SDL_SCANCODE_3, Keymap::three}, {SDL_SCANCODE_4, Keymap::four},
+          {SDL_SCANCODE_Q, Keymap::q}, {SDL_SCANCODE_W, Keymap::w},
+          {SDL_SCANCODE_E, Keymap::e}, {SDL_SCANCODE_R, Keymap::r},
+          {SDL_SCANCODE_A, Keymap::a}, {SDL_SCANCODE_S, Keymap::s},
+          {SDL_SCANCODE_D, Keymap::d}, {SDL_SCANCODE_F, Keymap::f},
+          {SDL_SCANCODE_Z, Keymap::z}, {SDL_SCANCODE_X, Keymap::x},
+          {SDL_SCANCODE_C, Keymap::c}, {SDL_SCANCODE_V, Keymap::v},
+      }};
+
+  std::array<int8_t, SDL_NUM_SCANCODES> table{};
+  table.fill(-1);
+  for (const auto &[scancode, key] : bindings) {
+    table[scancode] = static_cast<int8_t>(key);
+  }
+  return table;
+}();
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// bounded lock-free queue for exactly one producer and one consumer thread
+template <typename VALUE_T, std::size_t CAPACITY>
+class SPSCQueue {
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "CAPACITY must be a power of two");
+
+public:
+  // returns false if the queue is full
+  bool push(const VALUE_T &value) {
+    const auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    m_buffer[tail & (CAPACITY - 1)] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // oldest element or nullptr if the queue is empty, stays valid until pop()
+  const VALUE_T *front() const {
+    const auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &m_buffer[head & (CAPACITY - 1)];
+  }
+
+  void pop() {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  std::size_t size() const {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+
+private:
+  std::array<VALUE_T, CAPACITY> m_buffer{};
+  // keep the indices on separate cache lines so the threads don't contend
+  alignas(64) std::atomic<std::size_t> m_head{};
+  alignas(64) std::atomic<std::size_t> m_tail{};
+};
@@ -4,17 +4,42 @@
 #include <format>
 #include <iostream>
 #include <memory>
+#include <string>
 
 #include "SDL_defines.hpp"
 #include "UI.hpp"
 
-auto draw_textbox(const auto &element, const SDL_Rect &prev_bb,
-                  const auto draw_direction, const Context &context) {
+// the built-in font at 3x, about the size of the 24 pt TrueType one
+constexpr int GLYPH_SCALE = 3;
+
+// one copy out of the glyph atlas per character
+SDL_Rect draw_bitmap_text(const std::string &text, const int x, const int y,
+                          Context &context) {
+  constexpr int advance = (Font::GLYPH_WIDTH + 1) * GLYPH_SCALE;
+  auto *glyphs = context.glyphs();
 
-  auto *text = TTF_RenderText_Solid(context.font, element.content.c_str(),
-                                    SDL_Color{255, 255, 255, 255});
-  auto *texture = SDL_CreateTextureFromSurface(context.renderer, text);
+  SDL_Rect destination = {.x = x,
+                          .y = y,
+                          .w = Font::GLYPH_WIDTH * GLYPH_SCALE,
+                          .h = Font::GLYPH_HEIGHT * GLYPH_SCALE};
+  for (const auto c : text) {
+    const SDL_Rect source = {
+        .x = static_cast<int>(Font::glyph_index(c) * Font::GLYPH_WIDTH),
+        .y = 0,
+        .w = Font::GLYPH_WIDTH,
+        .h = Font::GLYPH_HEIGHT};
+    SDL_RenderCopy(context.renderer, glyphs, &source, &destination);
+    destination.x += advance;
+  }
+
+  return {.x = x,
+          .y = y,
+          .w = static_cast<int>(text.size()) * advance,
+          .h = (Font::GLYPH_HEIGHT + 1) * GLYPH_SCALE};
+}
 
+auto draw_textbox(const auto &element, const SDL_Rect &prev_bb,
+                  const auto draw_direction, Context &context) {
   auto bb_x = prev_bb.x + prev_bb.w;
   auto bb_y = prev_bb.y;
 
@@ -23,15 +48,26 @@ auto draw_textbox(const auto &element, const SDL_Rect &prev_bb,
     bb_y = prev_bb.y + prev_bb.h;
   }
 
-  SDL_Rect text_bounding_box = {.x = static_cast<int>(bb_x),
-                                .y = static_cast<int>(bb_y),
-                                .w = text->w,
-                                .h = text->h};
+#ifdef CHIP8_TTF
+  if (auto *font = context.font(); font != nullptr) {
+    auto *text = TTF_RenderText_Solid(font, element.content.c_str(),
+                                      SDL_Color{255, 255, 255, 255});
+    auto *texture = SDL_CreateTextureFromSurface(context.renderer, text);
+
+    SDL_Rect text_bounding_box = {.x = static_cast<int>(bb_x),
+                                  .y = static_cast<int>(bb_y),
+                                  .w = text->w,
+                                  .h = text->h};
 
-  SDL_FreeSurface(text);
-  SDL_RenderCopy(context.renderer, texture, nullptr, &text_bounding_box);
+    SDL_FreeSurface(text);
+    SDL_RenderCopy(context.renderer, texture, nullptr, &text_bounding_box);
+    SDL_DestroyTexture(texture);
+
+    return text_bounding_box;
+  }
+#endif
 
-  return text_bounding_box;
+  return draw_bitmap_text(element.content, bb_x, bb_y, context);
 }
 
 void UI::render(Context &context) {
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Upscaler.hpp"
+#include "config.hpp"
+
+namespace Render {
+namespace {
+constexpr std::size_t MAX_WIDTH = Emulator::Display::MAX_WIDTH;
+
+#if defined(__SSE2__)
+// all ones in the lanes of the pixels lit in a 4 bit group, leftmost first
+__m128i lane_mask(const uint32_t group) {
+  const auto bits = _mm_setr_epi32(8, 4, 2, 1);
+  return _mm_cmpeq_epi32(
+      _mm_and_si128(_mm_set1_epi32(static_cast<int>(group)), bits), bits);
+}
+
+__m128i select(const __m128i mask, const __m128i set, const __m128i unset) {
+  return _mm_or_si128(_mm_and_si128(mask, set), _mm_andnot_si128(mask, unset));
+}
+
+// count >= 4, the last store overlaps the one before it
+void fill(uint32_t *out, const __m128i color, const std::size_t count) {
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), color);
+  }
+  if (i < count) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + count - 4), color);
+  }
+}
+#endif
+} // namespace
+
+std::optional<Palette> parse_palette(std::string_view text) {
+  Palette palette{};
+  for (std::size_t i = 0; i < palette.size(); ++i) {
+    const auto comma = text.find(',');
+    auto color = text.substr(0, comma);
+    if (color.starts_with('#')) {
+      color.remove_prefix(1);
+    }
+    const auto [end, error] = std::from_chars(
+        color.data(), color.data() + color.size(), palette[i], 16);
+    if (color.size() != 6 || error != std::errc{} ||
+        end != color.data() + color.size()) {
+      return std::nullopt;
+    }
+
+    const bool last = i + 1 == palette.size();
+    if (last != (comma == std::string_view::npos)) {
+      return std::nullopt;
+    }
+    text.remove_prefix(last ? text.size() : comma + 1);
+  }
+  return palette;
+}
+
+Upscaler::Upscaler(const std::size_t width, const std::size_t height)
+    : m_width(width), m_height(height) {}
+
+void Upscaler::set_colors(const Palette &colors,
+                          const Palette &scanline_colors) {
+  m_colors = colors;
+  m_scanline_colors = scanline_colors;
+  m_valid = false;
+}
+
+void Upscaler::set_scanlines(const bool scanlines) {
+  m_scanlines = scanlines;
+  m_valid = false;
+}
+
+void Upscaler::layout(const bool hires) {
+  m_hires = hires;
+  m_source_width = hires ? MAX_WIDTH : Emulator::WIDTH;
+  m_source_height =
+      hires ? Emulator::Display::MAX_HEIGHT : Emulator::HEIGHT;
+  m_scale = std::max<std::size_t>(
+      1, std::min(m_width / m_source_width, m_height / m_source_height));
+
+  const auto image_width = m_source_width * m_scale;
+  const auto image_height = m_source_height * m_scale;
+  m_left = m_width > image_width ? (m_width - image_width) / 2 : 0;
+  m_top = m_height > image_height ? (m_height - image_height) / 2 : 0;
+
+  // the borders are never touched by expand(), an image wider than the
+  // target spills into the padding and is cut off when copied out
+  const auto line_size = std::max(m_width, m_left + image_width);
+  m_line.assign(line_size, m_colors[0]);
+  m_scanline.assign(line_size, m_colors[0]);
+}
+
+std::span<const Span> Upscaler::update(const Emulator::Display &display) {
+  m_spans.clear();
+
+  if (!m_valid || display.hires() != m_hires) {
+    layout(display.hires());
+    for (std::size_t plane = 0; plane < m_rows.size(); ++plane) {
+      for (std::size_t y = 0; y < m_source_height; ++y) {
+        m_rows[plane][y] = display.row(plane, y);
+      }
+    }
+    m_valid = true;
+    m_spans.push_back({0, m_height});
+    return m_spans;
+  }
+
+  // runs of changed rows become one span each
+  std::optional<std::size_t> first;
+  for (std::size_t y = 0; y <= m_source_height; ++y) {
+    bool changed = false;
+    for (std::size_t plane = 0; y < m_source_height && plane < m_rows.size();
+         ++plane) {
+      if (m_rows[plane][y] != display.row(plane, y)) {
+        m_rows[plane][y] = display.row(plane, y);
+        changed = true;
+      }
+    }
+
+    if (changed && !first.has_value()) {
+      first = y;
+    } else if (!changed && first.has_value()) {
+      const auto top = m_top + first.value() * m_scale;
+      if (top < m_height) {
+        m_spans.push_back(
+            {top, std::min((y - first.value()) * m_scale, m_height - top)});
+      }
+      first.reset();
+    }
+  }
+  return m_spans;
+}
+
+void Upscaler::draw(const Span &span, uint32_t *pixels,
+                    const std::size_t pitch) {
+  const auto image_bottom = m_top + m_source_height * m_scale;
+  std::optional<std::size_t> expanded;
+  std::optional<std::size_t> expanded_scanline;
+
+  for (std::size_t i = 0; i < span.height; ++i, pixels += pitch) {
+    const auto y = span.y + i;
+    if (y < m_top || y >= image_bottom) {
+      std::fill_n(pixels, m_width, m_colors[0]);
+      continue;
+    }
+
+    // every row of a scaled line is a copy of the same expanded line
+    const auto source_row = (y - m_top) / m_scale;
+    const bool scanline = m_scanlines && m_scale > 1 &&
+                          (y - m_top) % m_scale == m_scale - 1;
+    if (scanline && expanded_scanline != source_row) {
+      expand(source_row, m_scanline_colors, m_scanline);
+      expanded_scanline = source_row;
+    } else if (!scanline && expanded != source_row) {
+      expand(source_row, m_colors, m_line);
+      expanded = source_row;
+    }
+    std::memcpy(pixels, (scanline ? m_scanline : m_line).data(),
+                m_width * sizeof(uint32_t));
+  }
+}
+
+void Upscaler::expand(const std::size_t source_row, const Palette &colors,
+                      std::vector<uint32_t> &line) const {
+  const auto low = m_rows[0][source_row];
+  const auto high = m_rows[1][source_row];
+  auto *out = line.data() + m_left;
+
+#if defined(__SSE2__)
+  // four pixels at a time: the plane bits become lane masks that pick the
+  // colour, then every lane is broadcast into its scale wide run
+  if (m_scale >= 4) {
+    const auto c0 = _mm_set1_epi32(static_cast<int>(colors[0]));
+    const auto c1 = _mm_set1_epi32(static_cast<int>(colors[1]));
+    const auto c2 = _mm_set1_epi32(static_cast<int>(colors[2]));
+    const auto c3 = _mm_set1_epi32(static_cast<int>(colors[3]));
+
+    for (std::size_t x = 0; x < m_source_width; x += 4) {
+      const auto shift = MAX_WIDTH - 4 - x;
+      const auto plane_1 = lane_mask(static_cast<uint32_t>(low >> shift) & 0xF);
+      const auto plane_2 =
+          lane_mask(static_cast<uint32_t>(high >> shift) & 0xF);
+      const auto color = select(plane_2, select(plane_1, c3, c2),
+                                select(plane_1, c1, c0));
+
+      fill(out, _mm_shuffle_epi32(color, 0x00), m_scale);
+      fill(out + m_scale, _mm_shuffle_epi32(color, 0x55), m_scale);
+      fill(out + m_scale * 2, _mm_shuffle_epi32(color, 0xAA), m_scale);
+      fill(out + m_scale * 3, _mm_shuffle_epi32(color, 0xFF), m_scale);
+      out += m_scale * 4;
+    }
+    return;
+  }
+#endif
+
+  for (std::size_t x = 0; x < m_source_width; ++x, out += m_scale) {
+    const auto shift = MAX_WIDTH - 1 - x;
+    const auto index = static_cast<std::size_t>(((low >> shift) & 1) |
+                                                ((high >> shift) & 1) << 1);
+    std::fill_n(out, m_scale, colors[index]);
+  }
+}
+} // namespace Render
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "Display.hpp"
+
+namespace Render {
+// 0xRRGGBB, indexed by the lit planes of a pixel
+using Palette = std::array<uint32_t, 4>;
+
+constexpr Palette default_palette = {0x000000, 0xFFFFFF, 0xAAAAAA, 0x555555};
+
+// four comma separated RRGGBB colours: off, plane 1, plane 2, both planes
+std::optional<Palette> parse_palette(std::string_view text);
+
+// rows [y, y + height) of the target that need to be redrawn
+struct Span {
+  std::size_t y;
+  std::size_t height;
+};
+
+// Expands the bit-packed display into a target of any size at the largest
+// integer scale that fits, centred, optionally darkening the last line of
+// every scaled row like a scanline. It keeps the rows it drew last, so only
+// the spans of the target behind rows that changed are handed out again.
+class Upscaler {
+public:
+  Upscaler(std::size_t width, std::size_t height);
+
+  // colours already in the target's pixel format, forces a full redraw
+  void set_colors(const Palette &colors, const Palette &scanline_colors);
+  void set_scanlines(bool scanlines);
+
+  // spans of the target that differ from the last frame, in order
+  std::span<const Span> update(const Emulator::Display &display);
+
+  // fills a span returned by update(), pixels points at its first row
+  void draw(const Span &span, uint32_t *pixels, std::size_t pitch);
+
+  std::size_t scale() const { return m_scale; }
+
+private:
+  using Row = Emulator::Display::Row;
+
+  void layout(bool hires);
+  void expand(std::size_t source_row, const Palette &colors,
+              std::vector<uint32_t> &line) const;
+
+  std::size_t m_width;
+  std::size_t m_height;
+  Palette m_colors{};
+  Palette m_scanline_colors{};
+  bool m_scanlines{};
+
+  // geometry of the image for the current resolution
+  std::size_t m_source_width{};
+  std::size_t m_source_height{};
+  std::size_t m_scale{1};
+  std::size_t m_left{};
+  std::size_t m_top{};
+
+  std::array<std::array<Row, Emulator::Display::MAX_HEIGHT>,
+             Emulator::Display::PLANES>
+      m_rows{};
+  bool m_hires{};
+  bool m_valid{};
+  std::vector<Span> m_spans;
+
+  // one expanded output row, borders included
+  std::vector<uint32_t> m_line;
+  std::vector<uint32_t> m_scanline;
+};
+} // namespace Render
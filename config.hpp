@@ -10,11 +10,21 @@ constexpr auto WIDTH = 64;
 constexpr auto HEIGHT = 32;
 constexpr auto ASPECT_RATIO = WIDTH / HEIGHT;
 constexpr auto MEMORY_SIZE = 4096;
+// addresses wrap around to 12 bits like on the real hardware
+constexpr auto ADDRESS_MASK = MEMORY_SIZE - 1;
+static_assert((MEMORY_SIZE & ADDRESS_MASK) == 0,
+              "MEMORY_SIZE must be a power of two");
+// XO-CHIP addresses the full 16 bits
+constexpr auto XO_MEMORY_SIZE = 0x10000;
 constexpr auto STACK_SIZE = 256;
 constexpr auto REG_COUNT = 16;
 constexpr auto KEYBOARD_SIZE = 4 * 4;
 constexpr auto PROGMEM_START = 0x200;
 constexpr auto PROCESSOR_SPEED = 400;
+constexpr auto BIG_FONT_START = 0x50;
+constexpr auto RPL_FLAG_COUNT = 16;
+constexpr auto AUDIO_PATTERN_SIZE = 16;
+constexpr uint8_t DEFAULT_PITCH = 64;
 
 enum class Keymap: uint8_t {
   one = 0x1, two = 0x2, three = 0x3, four = 0xc,
@@ -41,4 +51,26 @@ constexpr std::array<uint8_t, 5 * 16> font = {
     0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
+
+// SUPER-CHIP 8x10 digits, extended with A-F like XO-CHIP
+constexpr std::array<uint8_t, 10 * 16> big_font = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+    0x3C, 0x7E, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+    0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+static_assert(BIG_FONT_START >= font.size() &&
+              BIG_FONT_START + big_font.size() <= PROGMEM_START);
 } // namespace Emulator
\ No newline at end of file
@@ -0,0 +1,441 @@
+// Coverage-guided fuzzing harness for the interpreter core.
+//
+// Input layout:
+//   byte 0            quirk profile (top 2 bits), number of key events K
+//   3 * K bytes       key events: step (u16, big endian), key (low nibble),
+//                     pressed (bit 4)
+//   remaining bytes   ROM image, loaded at PROGMEM_START
+//
+// Coverage is the sequence of opcode handlers: every pair of consecutive
+// handlers, and whether the second one fell through to the next instruction,
+// is one counter. Absolute PCs are left out, in random ROMs nearly every
+// address is new and would flood the corpus with inputs that differ only in
+// where their code sits.
+//
+// Built with -DCHIP8_LIBFUZZER (clang, -fsanitize=fuzzer) this exposes
+// LLVMFuzzerTestOneInput and publishes the handler edge map as libFuzzer
+// extra counters. Without it, a small in-process mutation loop is
+// compiled in instead so the harness also runs under gcc.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "CHIP8.hpp"
+#include "config.hpp"
+
+namespace {
+constexpr std::size_t MAX_STEPS = 4096;
+constexpr std::size_t STEPS_PER_TIMER_TICK = Emulator::PROCESSOR_SPEED / 60;
+// handler classes fit in 7 bits
+constexpr std::size_t HANDLER_CLASSES = 1 << 7;
+constexpr std::size_t COVERAGE_MAP_SIZE = HANDLER_CLASSES * HANDLER_CLASSES * 2;
+
+#ifdef CHIP8_LIBFUZZER
+__attribute__((section("__libfuzzer_extra_counters")))
+#endif
+std::array<uint8_t, COVERAGE_MAP_SIZE> coverage_map;
+
+// identifies which branch of single_step handles an instruction, 0 for the
+// undefined ones
+uint8_t handler_class(const Emulator::Instruction instruction) {
+  constexpr std::array<uint8_t, 16> f_handlers = {
+      0x00, 0x01, 0x02, 0x07, 0x0A, 0x15, 0x18, 0x1E,
+      0x29, 0x30, 0x33, 0x3A, 0x55, 0x65, 0x75, 0x85};
+
+  switch (instruction.opcode()) {
+  case 0x0:
+    // the full values, like the core
+    switch (instruction.value) {
+    case 0x0000:
+      return 1;
+    case 0x00E0:
+      return 2;
+    case 0x00EE:
+      return 3;
+    case 0x00FB:
+    case 0x00FC:
+    case 0x00FD:
+    case 0x00FE:
+    case 0x00FF:
+      return static_cast<uint8_t>(6 + instruction.NN() - 0xFB);
+    }
+    if ((instruction.value & 0xFFF0) == 0x00C0) {
+      return 4;
+    }
+    if ((instruction.value & 0xFFF0) == 0x00D0) {
+      return 5;
+    }
+    return 0;
+  case 0x5:
+    return instruction.N() <= 0x3 && instruction.N() != 0x1
+               ? static_cast<uint8_t>(32 + instruction.N())
+               : 0;
+  case 0x8:
+    return instruction.N() <= 0x7 || instruction.N() == 0xE
+               ? static_cast<uint8_t>(40 + instruction.N())
+               : 0;
+  case 0xD:
+    return instruction.N() == 0 ? 56 : 57;
+  case 0xE:
+    if (instruction.NN() == 0x9E || instruction.NN() == 0xA1) {
+      return instruction.NN() == 0x9E ? 58 : 59;
+    }
+    return 0;
+  case 0xF: {
+    const auto handler = std::ranges::find(f_handlers, instruction.NN());
+    return handler == f_handlers.end()
+               ? 0
+               : static_cast<uint8_t>(64 + (handler - f_handlers.begin()));
+  }
+  default:
+    return static_cast<uint8_t>(16 + instruction.opcode());
+  }
+}
+
+// one core per profile, reset by copying a pristine one over it rather than
+// constructing (and zeroing) up to 64 KB of core on every exec
+Emulator::AnyCHIP8 &fresh_core(const Emulator::Profile profile) {
+  using Emulator::Profile;
+  static const std::array pristine = {
+      Emulator::make_emulator(Profile::Modern),
+      Emulator::make_emulator(Profile::CHIP8),
+      Emulator::make_emulator(Profile::SuperChip),
+      Emulator::make_emulator(Profile::XOChip)};
+  static auto cores = pristine;
+
+  const auto index = static_cast<std::size_t>(profile) % pristine.size();
+  cores[index] = pristine[index];
+  return cores[index];
+}
+
+struct KeyEvent {
+  uint16_t step;
+  uint8_t key;
+  bool pressed;
+};
+
+void run_events(auto &emulator, std::span<const uint8_t> rom,
+                const std::vector<KeyEvent> &key_events) {
+  emulator.load_rom(rom);
+
+  auto next_event = key_events.begin();
+  std::size_t previous_class = 0;
+
+  for (std::size_t step = 0; step < MAX_STEPS; ++step) {
+    for (; next_event != key_events.end() && next_event->step <= step;
+         ++next_event) {
+      emulator.set_key(next_event->key, next_event->pressed);
+    }
+
+    if (step % STEPS_PER_TIMER_TICK == 0) {
+      emulator.timer_tick();
+    }
+
+    const auto &state = emulator.state();
+    const auto pc = state.program_counter & (state.memory.size() - 1);
+    const auto instruction = Emulator::Instruction(state.memory, pc);
+    const auto running = emulator.single_step();
+
+    // instructions a profile doesn't have fault, whatever they decode to
+    const std::size_t current_class =
+        emulator.fault() == Emulator::Fault::UnknownInstruction
+            ? 0
+            : handler_class(instruction);
+    const bool fell_through = state.program_counter == pc + 2;
+    auto &counter = coverage_map[(previous_class * HANDLER_CLASSES +
+                                  current_class) * 2 + fell_through];
+    // saturating like libFuzzer's own counters, a hot edge never looks unseen
+    if (counter != 0xFF) {
+      ++counter;
+    }
+    previous_class = current_class;
+
+    if (!running) {
+      break;
+    }
+  }
+}
+
+void run_one(std::span<const uint8_t> data) {
+  std::vector<KeyEvent> key_events;
+  auto profile = Emulator::Profile::Modern;
+
+  if (!data.empty()) {
+    profile = static_cast<Emulator::Profile>(data[0] >> 6);
+    const std::size_t event_count =
+        std::min<std::size_t>(data[0] & 0x3F, (data.size() - 1) / 3);
+    for (std::size_t i = 0; i < event_count; ++i) {
+      const auto *event = &data[1 + i * 3];
+      key_events.push_back(
+          {static_cast<uint16_t>((event[0] << 8) | event[1]),
+           static_cast<uint8_t>(event[2] & 0x0F), (event[2] & 0x10) != 0});
+    }
+    // stable, a press and a release at the same step replay in input order
+    std::ranges::stable_sort(key_events, {}, &KeyEvent::step);
+    data = data.subspan(1 + event_count * 3);
+  }
+
+  std::visit([&](auto &emulator) { run_events(emulator, data, key_events); },
+             fresh_core(profile));
+}
+} // namespace
+
+#ifdef CHIP8_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, std::size_t size) {
+  run_one({data, size});
+  return 0;
+}
+
+#else
+
+namespace {
+constexpr std::size_t DEFAULT_MAX_LEN = 1024;
+constexpr std::string_view CRASH_FILENAME = "crash-input.bin";
+
+// the input currently executing, written out if the process dies
+std::vector<uint8_t> current_input;
+
+void dump_current_input() {
+  if (auto *file = std::fopen(CRASH_FILENAME.data(), "wb")) {
+    std::fwrite(current_input.data(), 1, current_input.size(), file);
+    std::fclose(file);
+  }
+}
+
+// run under ASan with ASAN_OPTIONS=abort_on_error=1 so sanitizer reports
+// also end up here
+extern "C" void on_fatal_signal(int signal) {
+  dump_current_input();
+  std::signal(signal, SIG_DFL);
+  std::raise(signal);
+}
+
+// bucket hit counts the same way libFuzzer does so loops that run a few more
+// iterations don't all count as new coverage
+constexpr uint8_t count_class(const uint8_t count) {
+  if (count == 0) return 0;
+  if (count == 1) return 1;
+  if (count == 2) return 2;
+  if (count == 3) return 4;
+  if (count < 8) return 8;
+  if (count < 16) return 16;
+  if (count < 32) return 32;
+  if (count < 128) return 64;
+  return 128;
+}
+
+class Corpus {
+public:
+  // returns true if the last execution reached new edges or hit counts
+  bool merge_coverage() {
+    bool new_coverage = false;
+    for (std::size_t i = 0; i < COVERAGE_MAP_SIZE; ++i) {
+      // most of the map is untouched, skip it a word at a time
+      if (i % sizeof(uint64_t) == 0) {
+        uint64_t word;
+        std::memcpy(&word, &coverage_map[i], sizeof(word));
+        if (word == 0) {
+          i += sizeof(uint64_t) - 1;
+          continue;
+        }
+      }
+      const auto bucket = count_class(coverage_map[i]);
+      if ((bucket & ~m_seen[i]) != 0) {
+        if (m_seen[i] == 0) {
+          ++m_edges;
+        }
+        m_seen[i] |= bucket;
+        new_coverage = true;
+      }
+    }
+    coverage_map.fill(0);
+    return new_coverage;
+  }
+
+  void add(std::vector<uint8_t> input) { m_inputs.push_back(std::move(input)); }
+
+  const auto &pick(auto &rng) const {
+    return m_inputs[std::uniform_int_distribution<std::size_t>(
+        0, m_inputs.size() - 1)(rng)];
+  }
+
+  std::size_t size() const { return m_inputs.size(); }
+  std::size_t edges() const { return m_edges; }
+
+private:
+  std::vector<std::vector<uint8_t>> m_inputs;
+  std::array<uint8_t, COVERAGE_MAP_SIZE> m_seen{};
+  std::size_t m_edges{};
+};
+
+void mutate(std::vector<uint8_t> &input, const Corpus &corpus,
+            const std::size_t max_len, auto &rng) {
+  auto random = [&rng](std::size_t bound) {
+    return std::uniform_int_distribution<std::size_t>(0, bound - 1)(rng);
+  };
+  // opcodes that are worth splicing in verbatim
+  constexpr std::array<uint16_t, 24> interesting = {
+      0x00E0, 0x00EE, 0x2200, 0xAFFF, 0xD00F, 0xF033, 0xFF55, 0xFF65,
+      0xF01E, 0xF00A, 0x8006, 0x800E, 0x00FF, 0x00C5, 0x00FB, 0xD010,
+      0xF000, 0xF301, 0x50F2, 0x5F03, 0xF002, 0xFF75, 0xF030, 0x00D3};
+
+  const auto mutation_count = 1 + random(4);
+  for (std::size_t m = 0; m < mutation_count; ++m) {
+    switch (random(input.empty() ? 1 : 7)) {
+    case 0: // insert a random byte
+      if (input.size() < max_len) {
+        input.insert(std::next(input.begin(), static_cast<std::ptrdiff_t>(
+                                                  random(input.size() + 1))),
+                     static_cast<uint8_t>(random(256)));
+      }
+      break;
+    case 1: // flip a bit
+      input[random(input.size())] ^= static_cast<uint8_t>(1 << random(8));
+      break;
+    case 2: // overwrite a byte
+      input[random(input.size())] = static_cast<uint8_t>(random(256));
+      break;
+    case 3: // erase a range
+      if (input.size() > 1) {
+        const auto from = random(input.size());
+        const auto to = std::min(input.size(), from + 1 + random(8));
+        input.erase(std::next(input.begin(), static_cast<std::ptrdiff_t>(from)),
+                    std::next(input.begin(), static_cast<std::ptrdiff_t>(to)));
+      }
+      break;
+    case 4: { // write an interesting opcode
+      if (input.size() < 2) {
+        break;
+      }
+      const auto value = interesting[random(interesting.size())];
+      const auto at = random(input.size() - 1);
+      input[at] = static_cast<uint8_t>(value >> 8);
+      input[at + 1] = static_cast<uint8_t>(value & 0xFF);
+      break;
+    }
+    case 5: { // splice with another corpus entry
+      const auto &other = corpus.pick(rng);
+      if (other.empty()) {
+        break;
+      }
+      const auto at = random(input.size());
+      input.resize(at);
+      const auto from = random(other.size());
+      input.insert(input.end(),
+                   std::next(other.begin(), static_cast<std::ptrdiff_t>(from)),
+                   other.end());
+      break;
+    }
+    case 6: // duplicate a chunk
+      if (input.size() * 2 <= max_len) {
+        const auto from = random(input.size());
+        const auto length = std::min(input.size() - from, 1 + random(16));
+        const std::vector<uint8_t> chunk(
+            std::next(input.begin(), static_cast<std::ptrdiff_t>(from)),
+            std::next(input.begin(),
+                      static_cast<std::ptrdiff_t>(from + length)));
+        input.insert(std::next(input.begin(), static_cast<std::ptrdiff_t>(
+                                                  random(input.size() + 1))),
+                     chunk.begin(), chunk.end());
+      }
+      break;
+    }
+  }
+
+  if (input.size() > max_len) {
+    input.resize(max_len);
+  }
+}
+
+std::vector<uint8_t> read_file(const char *filename) {
+  std::ifstream istrm(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(istrm),
+          std::istreambuf_iterator<char>()};
+}
+} // namespace
+
+// usage: chip8_fuzz [-runs=N] [-seed=N] [-max_len=N] [input files...]
+int main(int argc, char **argv) {
+  std::size_t runs = 0; // 0 runs forever
+  std::size_t max_len = DEFAULT_MAX_LEN;
+  uint64_t seed = std::random_device{}();
+  std::vector<std::vector<uint8_t>> seeds;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with("-runs=")) {
+      runs = std::strtoull(argv[i] + 6, nullptr, 10);
+    } else if (arg.starts_with("-seed=")) {
+      seed = std::strtoull(argv[i] + 6, nullptr, 10);
+    } else if (arg.starts_with("-max_len=")) {
+      max_len = std::max<std::size_t>(1, std::strtoull(argv[i] + 9, nullptr, 10));
+    } else {
+      seeds.push_back(read_file(argv[i]));
+    }
+  }
+
+  std::signal(SIGSEGV, on_fatal_signal);
+  std::signal(SIGABRT, on_fatal_signal);
+  std::signal(SIGFPE, on_fatal_signal);
+  std::set_terminate([] {
+    dump_current_input();
+    std::abort();
+  });
+
+  std::mt19937_64 rng(seed);
+  Corpus corpus;
+
+  // always start with at least an empty input
+  if (seeds.empty()) {
+    seeds.emplace_back();
+  }
+  for (auto &input : seeds) {
+    current_input = input;
+    run_one(current_input);
+    corpus.merge_coverage();
+    corpus.add(std::move(input));
+  }
+
+  std::cout << "seed: " << seed << ", corpus: " << corpus.size()
+            << ", edges: " << corpus.edges() << std::endl;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t exec = 1; runs == 0 || exec <= runs; ++exec) {
+    current_input = corpus.pick(rng);
+    mutate(current_input, corpus, max_len, rng);
+    run_one(current_input);
+
+    if (corpus.merge_coverage()) {
+      corpus.add(current_input);
+    }
+
+    if ((exec & (exec - 1)) == 0 || exec == runs) {
+      const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << "#" << exec << " edges: " << corpus.edges()
+                << " corpus: " << corpus.size() << " exec/s: "
+                << static_cast<uint64_t>(static_cast<double>(exec) /
+                                         std::max(elapsed.count(), 1e-9))
+                << std::endl;
+    }
+  }
+
+  return 0;
+}
+
+#endif
@@ -1,30 +1,130 @@
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdlib>
 #include <format>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
+#include "Audio.hpp"
+#include "Capture.hpp"
 #include "CHIP8.hpp"
+#include "CHIP8_API.h"
+#include "Debugger.hpp"
+#include "Lockstep.hpp"
 #include "UI.hpp"
+#include "Upscaler.hpp"
 #include "config.hpp"
 #include "SDL_defines.hpp"
 
+// time from an input event's SDL timestamp until the next frame is presented
+struct InputLatency {
+  void input(const uint32_t timestamp) {
+    if (!pending.has_value()) {
+      pending = timestamp;
+    }
+  }
+
+  void presented(const uint32_t timestamp) {
+    if (!pending.has_value()) {
+      return;
+    }
+    const auto latency = timestamp - pending.value();
+    pending.reset();
+
+    ++samples;
+    total_ms += latency;
+    max_ms = std::max(max_ms, latency);
+  }
+
+  void report() const {
+    if (samples == 0) {
+      return;
+    }
+    std::cout << std::format(
+        "Input latency over {} events: avg {:.1f} ms, max {} ms\n", samples,
+        static_cast<double>(total_ms) / static_cast<double>(samples), max_ms);
+  }
+
+  std::optional<uint32_t> pending;
+  uint64_t samples{};
+  uint64_t total_ms{};
+  uint32_t max_ms{};
+};
+
+// time from entering main() to the first presented frame, split into the
+// steps on the way there
+struct StartupProfile {
+  using Clock = std::chrono::steady_clock;
+
+  void mark(const std::string_view step) {
+    if (enabled && !reported) {
+      steps.emplace_back(step, Clock::now());
+    }
+  }
+
+  // called after every frame, reports once
+  void first_frame() {
+    if (!enabled || reported) {
+      return;
+    }
+    mark("first frame");
+    reported = true;
+
+    std::string report = "Startup:";
+    auto previous = start;
+    for (const auto &[step, time] : steps) {
+      report += std::format(
+          " {} +{:.1f} ms,", step,
+          std::chrono::duration<double, std::milli>(time - previous).count());
+      previous = time;
+    }
+    report.pop_back();
+    std::cout << std::format(
+        "{}\nTime to first frame: {:.1f} ms\n", report,
+        std::chrono::duration<double, std::milli>(previous - start).count());
+  }
+
+  bool enabled{};
+  bool reported{};
+  Clock::time_point start{Clock::now()};
+  std::vector<std::pair<std::string_view, Clock::time_point>> steps;
+};
+
 // handles input for both the emulator and window events
-static Key handle_input(auto &emulator, auto &instruction_timer) {
-  using Emulator::Keymap;
+static Key handle_input(auto &emulator, auto &instruction_timer,
+                        InputLatency &input_latency) {
   using namespace std::chrono_literals;
 
   SDL_Event event;
-  auto keydown = [&emulator](Keymap key) {
-    emulator.set_last_key(static_cast<uint8_t>(key));
-  };
 
-  // todo: find a smarter way to handle mapping key events
   while (SDL_PollEvent(&event) != 0) {
     switch (event.type) {
     case SDL_QUIT:
       return Key::Exit;
     case SDL_KEYDOWN:
+    case SDL_KEYUP: {
+      const bool pressed = event.type == SDL_KEYDOWN;
+      const auto scancode = static_cast<std::size_t>(event.key.keysym.scancode);
+
+      if (scancode < keypad_lookup.size() && keypad_lookup[scancode] >= 0) {
+        if (!event.key.repeat) {
+          emulator.set_key(static_cast<uint8_t>(keypad_lookup[scancode]),
+                           pressed);
+          input_latency.input(event.key.timestamp);
+        }
+        break;
+      }
+
+      if (!pressed) {
+        break;
+      }
+
       switch (event.key.keysym.sym) {
       case SDLK_ESCAPE:
         return Key::Exit;
@@ -37,60 +137,24 @@ static Key handle_input(auto &emulator, auto &instruction_timer) {
       case SDLK_u:
         instruction_timer.interval = 1000ms / Emulator::PROCESSOR_SPEED;
         break;
-      case SDLK_1:
-        keydown(Keymap::one);
-        break;
-      case SDLK_2:
-        keydown(Keymap::two);
-        break;
-      case SDLK_3:
-        keydown(Keymap::three);
-        break;
-      case SDLK_4:
-        keydown(Keymap::four);
-        break;
-      case SDLK_q:
-        keydown(Keymap::q);
-        break;
-      case SDLK_w:
-        keydown(Keymap::w);
-        break;
-      case SDLK_e:
-        keydown(Keymap::e);
-        break;
-      case SDLK_r:
-        keydown(Keymap::r);
-        break;
-      case SDLK_a:
-        keydown(Keymap::a);
-        break;
-      case SDLK_s:
-        keydown(Keymap::s);
-        break;
-      case SDLK_d:
-        keydown(Keymap::d);
-        break;
-      case SDLK_f:
-        keydown(Keymap::f);
-        break;
-      case SDLK_z:
-        keydown(Keymap::z);
-        break;
-      case SDLK_x:
-        keydown(Keymap::x);
-        break;
-      case SDLK_c:
-        keydown(Keymap::c);
-        break;
-      case SDLK_v:
-        keydown(Keymap::v);
-        break;
       case SDLK_p:
         return Key::Pause;
+      case SDLK_BACKQUOTE:
+        return Key::ToggleDebugger;
+      case SDLK_F5:
+        return Key::Continue;
+      case SDLK_F9:
+        return Key::ToggleBreakpoint;
+      case SDLK_F10:
+        return Key::StepOver;
+      case SDLK_F11:
+        return (event.key.keysym.mod & KMOD_SHIFT) ? Key::StepOut
+                                                   : Key::StepInto;
       default:
         break;
       }
       break;
+    }
     default:
       break;
     }
@@ -99,37 +163,32 @@ static Key handle_input(auto &emulator, auto &instruction_timer) {
   return Key::None;
 }
 
-static void render_frame(auto &context, auto &emulator, auto& user_interface) {
-  SDL_SetRenderDrawColor(context.renderer, 0, 0, 0, 255);
-  SDL_RenderClear(context.renderer);
-
-  int pitch;
-  SDL_LockTexture(context.chip8_screen, NULL, (void **)&context.pixels, &pitch);
-
-  const auto color = SDL_MapRGBA(context.pixel_format, 255, 255, 255, 255);
-  
-  if (!emulator.need_clear_screen()) {
-    SDL_UnlockTexture(context.chip8_screen);
-    for (int y = 0; y < Emulator::HEIGHT; ++y) {
-      for (int x = 0; x < Emulator::WIDTH; ++x) {
-        const auto coordinate = y * Emulator::WIDTH + x;
-        context.pixels[coordinate] = emulator.get_pixel(coordinate) > 0 ? color : 0;
+static void render_frame(auto &context, auto &emulator, auto& user_interface,
+                         InputLatency &input_latency) {
+  // only the rows that changed since the last frame are expanded and locked
+  if (emulator.need_repaint()) {
+    for (const auto &span : context.upscaler.update(emulator.display())) {
+      const SDL_Rect rect = {.x = 0,
+                             .y = static_cast<int>(span.y),
+                             .w = static_cast<int>(context.width),
+                             .h = static_cast<int>(span.height)};
+      uint32_t *pixels;
+      int pitch;
+      if (SDL_LockTexture(context.chip8_screen, &rect,
+                          reinterpret_cast<void **>(&pixels), &pitch) < 0) {
+        SDL_Log("Couldn't lock texture %s\n", SDL_GetError());
+        exit(1);
       }
+      context.upscaler.draw(span, pixels,
+                            static_cast<std::size_t>(pitch) / sizeof(uint32_t));
+      SDL_UnlockTexture(context.chip8_screen);
     }
-    SDL_UnlockTexture(context.chip8_screen);
-  }
-
-  emulator.set_need_clear_screen(false);
 
-  // maintain chip8 aspect ratio
-  const auto target_height = WINDOW_WIDTH / Emulator::ASPECT_RATIO;
-  SDL_Rect window_rect = {.x = 0,
-                          .y = (WINDOW_HEIGHT - target_height) / 2,
-                          .w = WINDOW_WIDTH,
-                          .h = target_height};
+    emulator.set_need_repaint(false);
+  }
 
   if (SDL_RenderCopy(context.renderer, context.chip8_screen, nullptr,
-                     &window_rect) < 0) {
+                     nullptr) < 0) {
     SDL_Log("Couldn't load %s\n", SDL_GetError());
     exit(1);
   }
@@ -137,6 +196,41 @@ static void render_frame(auto &context, auto &emulator, auto& user_interface) {
   user_interface.render(context);
 
   SDL_RenderPresent(context.renderer);
+  input_latency.presented(SDL_GetTicks());
+}
+
+// registers, stack and disassembly around the PC
+static void draw_debugger(UI &user_interface, const auto &emulator,
+                          const auto &debugger) {
+  const auto &state = emulator.state();
+
+  user_interface.container_start({DrawDirection::Vertical});
+
+  user_interface.textbox(debugger.message().empty() ? "Running"
+                                                    : debugger.message());
+  for (std::size_t half = 0; half < 2; ++half) {
+    std::string registers;
+    for (std::size_t i = half * 8; i < half * 8 + 8; ++i) {
+      registers += std::format("V{:X} {:02X}  ", i, state.registers[i]);
+    }
+    user_interface.textbox(registers);
+  }
+  user_interface.textbox(std::format("PC {:03X}  I {:03X}  DT {:02X}  ST {:02X}",
+                                     state.program_counter,
+                                     state.index_register, state.delay_timer,
+                                     state.sound_timer));
+
+  std::string stack = "Stack";
+  for (const auto address : state.stack.entries()) {
+    stack += std::format(" {:03X}", address);
+  }
+  user_interface.textbox(stack);
+
+  for (const auto &line : debugger.listing(state.program_counter, 8)) {
+    user_interface.textbox(line);
+  }
+
+  user_interface.container_end();
 }
 
 struct Timer {
@@ -167,34 +261,155 @@ auto init_timers() {
   return std::array{frame_timer, timer_timer, instruction_timer};
 }
 
-int main() {
+struct Options {
   std::string_view game_name = "particles.ch8";
+  Emulator::Profile profile = Emulator::Profile::Modern;
+  uint16_t audio_buffer_frames = Audio::DEFAULT_BUFFER_FRAMES;
+  // run this many instructions without a window, as fast as possible
+  std::optional<uint64_t> headless_cycles;
+  std::string_view wav_filename;
+  // video of a headless run, the format follows the extension
+  std::string_view capture_filename;
+  bool input_latency = false;
+  // serve the emulator to other processes through this shared memory object
+  std::string_view shm_name;
+  std::vector<std::size_t> breakpoints;
+  std::vector<Emulator::Watchpoint> watchpoints;
+  std::vector<Emulator::Condition> conditions;
+  // run a second core next to the first and report where they diverge
+  std::optional<Emulator::Profile> lockstep_profile;
+  uint64_t lockstep_interval = 1000;
+  Render::Palette palette = Render::default_palette;
+  bool scanlines = false;
+  // TrueType font for the debugger, the built-in bitmap font otherwise
+  std::string_view font_path;
+};
 
-  Context context(game_name, WINDOW_WIDTH, WINDOW_HEIGHT);
-  Emulator::CHIP8 emulator;
+// sends the sound state to the audio thread when it changes, or always for a
+// heartbeat so the synthesizer can follow emulated time
+static void queue_sound(const auto &emulator, auto &audio,
+                        Audio::SoundState &last_sound,
+                        const double cycles_per_second,
+                        const bool heartbeat = false) {
+  const auto sound = Audio::sound_state(emulator);
+  // a full queue keeps last_sound, so the change is sent again next time
+  if ((heartbeat || sound != last_sound) &&
+      audio.push({emulator.cycle_count(), cycles_per_second, sound})) {
+    last_sound = sound;
+  }
+}
+
+static void report_termination(const auto &emulator) {
+  std::cout << std::format(
+      "Emulator terminated execution (fault {}, pc 0x{:03x})\n",
+      static_cast<uint32_t>(emulator.fault()),
+      emulator.state().program_counter);
+}
+
+// 0xRRGGBB colours in the texture's pixel format, shift darkens them
+static Render::Palette map_palette(const SDL_PixelFormat *format,
+                                   const Render::Palette &palette,
+                                   const unsigned shift) {
+  Render::Palette mapped{};
+  for (std::size_t i = 0; i < palette.size(); ++i) {
+    const auto channel = [&](const unsigned offset) {
+      return static_cast<uint8_t>(((palette[i] >> offset) & 0xFF) >> shift);
+    };
+    mapped[i] = SDL_MapRGBA(format, channel(16), channel(8), channel(0), 255);
+  }
+  return mapped;
+}
+
+static int run(auto &context, auto &emulator, const Options &options,
+               StartupProfile &startup_profile) {
   UI user_interface;
 
-  if (!emulator.load_rom(game_name)) {
-    std::cout << std::format("Could not open ROM: {}\n", game_name);
+  // scanlines at half brightness
+  context.upscaler.set_colors(
+      map_palette(context.pixel_format, options.palette, 0),
+      map_palette(context.pixel_format, options.palette, 1));
+  context.upscaler.set_scanlines(options.scanlines);
+
+  if (!emulator.load_rom(options.game_name)) {
+    std::cout << std::format("Could not open ROM: {}\n", options.game_name);
     return 1;
   }
 
-  std::cout << std::format("ROM loaded: {}\n", game_name);
+  std::cout << std::format("ROM loaded: {}\n", options.game_name);
+  startup_profile.mark("ROM");
 
   auto [frame_timer, timer_timer, instruction_timer] = init_timers();
 
+  Audio::Output audio(options.audio_buffer_frames);
+  Audio::SoundState last_sound{};
+  const auto cycles_per_second = [&instruction_timer] {
+    return 1000.0 / instruction_timer.interval.count();
+  };
+
+  InputLatency input_latency;
   bool paused = false;
+  const auto set_paused = [&](const bool value) {
+    paused = value;
+
+    auto sound = Audio::sound_state(emulator);
+    sound.playing = sound.playing && !paused;
+    audio.push({emulator.cycle_count(), cycles_per_second(), sound});
+  };
+
+  Emulator::Debugger debugger(emulator);
+  for (const auto address : options.breakpoints) {
+    debugger.add_breakpoint(address);
+  }
+  for (const auto &watchpoint : options.watchpoints) {
+    debugger.add_watchpoint(watchpoint);
+  }
+  for (const auto &condition : options.conditions) {
+    debugger.add_condition(condition);
+  }
+  bool show_debugger = false;
 
   for (Key key{}; key != Key::Exit;) {
-    key = handle_input(emulator, instruction_timer);
+    key = handle_input(emulator, instruction_timer, input_latency);
 
-    if (key == Key::Pause) {
-      paused = !paused;
+    switch (key) {
+    case Key::Pause:
+      set_paused(!paused);
+      break;
+    case Key::ToggleDebugger:
+      show_debugger = !show_debugger;
+      break;
+    case Key::ToggleBreakpoint:
+      debugger.toggle_breakpoint(emulator.state().program_counter);
+      break;
+    case Key::Continue:
+      debugger.resume();
+      set_paused(false);
+      break;
+    case Key::StepInto:
+      debugger.step_into();
+      set_paused(false);
+      break;
+    case Key::StepOver:
+      debugger.step_over();
+      set_paused(false);
+      break;
+    case Key::StepOut:
+      if (debugger.step_out()) {
+        set_paused(false);
+      } else {
+        std::cout << debugger.message() << '\n';
+      }
+      break;
+    default:
+      break;
     }
 
     const auto now = std::chrono::system_clock::now();
 
     if (frame_timer.exec(now)) {
+      // a sound change the full queue held back, e.g. the pause silence
+      audio.flush();
+
       if (user_interface.container_start()) {
         // user_interface.textbox("Tab 1");
         // user_interface.textbox("Tab 2");
@@ -203,32 +418,300 @@ int main() {
 
         user_interface.container_end();
       }
-      
-      render_frame(context, emulator, user_interface);
+
+      if (show_debugger) {
+        draw_debugger(user_interface, emulator, debugger);
+      }
+
+      render_frame(context, emulator, user_interface, input_latency);
+      startup_profile.first_frame();
     }
 
     if (!paused) {
       if (timer_timer.exec(now)) {
-        if (emulator.sound_playing()) {
-          Mix_PlayChannel(0, context.beep, 0);
-        } else {
-          Mix_HaltChannel(0);
-        }
-
         emulator.timer_tick();
+        queue_sound(emulator, audio, last_sound, cycles_per_second(), true);
       }
 
       if (instruction_timer.exec(now)) {
-        if (!emulator.single_step()) {
-          std::cout << "Emulator terminated execution\n";
+        const auto stop = debugger.step();
+        if (stop == Emulator::Stop::Halted) {
+          report_termination(emulator);
           break;
         }
+        queue_sound(emulator, audio, last_sound, cycles_per_second());
+
+        if (stop != Emulator::Stop::None) {
+          std::cout << debugger.message() << '\n';
+          show_debugger = true;
+          set_paused(true);
+        }
       }
     }
   }
 
-  Mix_CloseAudio();
-  SDL_Quit();
+  if (options.input_latency) {
+    input_latency.report();
+  }
 
   return 0;
 }
+
+static int run_headless(auto &emulator, const Options &options) {
+  if (!emulator.load_rom(options.game_name)) {
+    std::cout << std::format("Could not open ROM: {}\n", options.game_name);
+    return 1;
+  }
+
+  std::optional<Capture::Writer> capture;
+  std::string wav_filename{options.wav_filename};
+  if (!options.capture_filename.empty()) {
+    const auto format = Capture::format_from_filename(options.capture_filename);
+    if (!format.has_value()) {
+      std::cout << std::format("Unknown capture format: {}\n",
+                               options.capture_filename);
+      return 1;
+    }
+    capture.emplace(options.capture_filename, format.value());
+    if (!capture->is_open()) {
+      std::cout << std::format("Could not open {}\n", options.capture_filename);
+      return 1;
+    }
+    // every capture gets its audio track unless one was asked for explicitly
+    if (wav_filename.empty()) {
+      wav_filename = std::format("{}.wav", options.capture_filename);
+    }
+  }
+
+  std::optional<Audio::WavWriter> wav;
+  if (!wav_filename.empty()) {
+    wav.emplace(wav_filename, Audio::SAMPLE_RATE);
+    if (!wav->is_open()) {
+      std::cout << std::format("Could not open {}\n", wav_filename);
+      return 1;
+    }
+  }
+
+  // same synthesizer as the SDL backend, but clocked purely by emulated cycles
+  Audio::EventQueue events;
+  Audio::Synthesizer synthesizer(Audio::SAMPLE_RATE);
+  Audio::SoundState last_sound{};
+  std::vector<int16_t> samples;
+  uint64_t samples_written = 0;
+
+  const auto render_audio = [&] {
+    if (!wav.has_value()) {
+      return;
+    }
+    const auto due = emulator.cycle_count() * Audio::SAMPLE_RATE /
+                     Emulator::PROCESSOR_SPEED;
+    samples.resize(due - samples_written);
+    synthesizer.render(samples, events);
+    wav->write(samples);
+    samples_written = due;
+  };
+
+  constexpr auto cycles_per_tick = Emulator::PROCESSOR_SPEED / 60.0;
+  double next_tick = 0;
+
+  while (emulator.cycle_count() < options.headless_cycles.value()) {
+    if (static_cast<double>(emulator.cycle_count()) >= next_tick) {
+      next_tick += cycles_per_tick;
+      emulator.timer_tick();
+      queue_sound(emulator, events, last_sound, Emulator::PROCESSOR_SPEED);
+      render_audio();
+      if (capture.has_value()) {
+        capture->submit(emulator.display(), emulator.cycle_count());
+      }
+    }
+
+    if (!emulator.single_step()) {
+      report_termination(emulator);
+      break;
+    }
+    queue_sound(emulator, events, last_sound, Emulator::PROCESSOR_SPEED);
+  }
+
+  render_audio();
+
+  if (capture.has_value()) {
+    std::cout << std::format("Captured {} frames, {} unique\n",
+                             capture->frames(), capture->unique_frames());
+  }
+
+  return 0;
+}
+
+// both cores get the same ROM, timer ticks and cycle budget as a headless run
+static int run_lockstep(auto &reference, auto &candidate,
+                        const Options &options) {
+  if (!reference.load_rom(options.game_name) ||
+      !candidate.load_rom(options.game_name)) {
+    std::cout << std::format("Could not open ROM: {}\n", options.game_name);
+    return 1;
+  }
+
+  Emulator::Lockstep lockstep(reference, candidate, options.lockstep_interval);
+
+  constexpr auto cycles_per_tick = Emulator::PROCESSOR_SPEED / 60.0;
+  double next_tick = 0;
+
+  while (!lockstep.divergence().has_value() &&
+         lockstep.cycle_count() < options.headless_cycles.value()) {
+    if (static_cast<double>(lockstep.cycle_count()) >= next_tick) {
+      next_tick += cycles_per_tick;
+      lockstep.timer_tick();
+    }
+    if (!lockstep.single_step()) {
+      break;
+    }
+  }
+  lockstep.verify();
+
+  if (const auto &divergence = lockstep.divergence(); divergence.has_value()) {
+    // decoded from the opcode that ran, memory may have changed since
+    const std::array opcode = {static_cast<uint8_t>(divergence->opcode >> 8),
+                               static_cast<uint8_t>(divergence->opcode)};
+    std::cout << std::format(
+        "Diverged after {} instructions at pc 0x{:03x}: {:04X} {}\n  {}\n",
+        divergence->cycle, divergence->program_counter, divergence->opcode,
+        Emulator::disassemble(Emulator::Instruction(opcode, 0)),
+        divergence->differences);
+    return 2;
+  }
+
+  std::cout << std::format("No divergence in {} instructions{}\n",
+                           lockstep.cycle_count(),
+                           lockstep.halted() ? ", both halted" : "");
+  return 0;
+}
+
+
+// usage: CHIP8 [--profile modern|chip8|schip|xochip] [--audio-buffer frames]
+//              [--headless cycles] [--wav file] [--capture file]
+//              [--input-latency]
+//              [--shm name] [--break addr] [--watch from-to:rw]
+//              [--break-if V3==5]
+//              [--lockstep profile] [--lockstep-interval n]
+//              [--palette 000000,ffffff,aaaaaa,555555] [--scanlines]
+//              [--font file.ttf] [--startup-profile] [rom]
+int main(int argc, char **argv) {
+  StartupProfile startup_profile;
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--profile" && has_value) {
+      const auto selected = Emulator::profile_from_name(argv[++i]);
+      if (!selected.has_value()) {
+        std::cout << std::format("Unknown profile: {}\n", argv[i]);
+        return 1;
+      }
+      options.profile = selected.value();
+    } else if (arg == "--audio-buffer" && has_value) {
+      const auto frames = Emulator::parse_number(argv[++i]);
+      if (!frames.has_value() || frames.value() == 0) {
+        std::cout << std::format("Invalid audio buffer: {}\n", argv[i]);
+        return 1;
+      }
+      options.audio_buffer_frames = Audio::buffer_frames(frames.value());
+    } else if (arg == "--headless" && has_value) {
+      options.headless_cycles = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--wav" && has_value) {
+      options.wav_filename = argv[++i];
+    } else if (arg == "--capture" && has_value) {
+      options.capture_filename = argv[++i];
+    } else if (arg == "--input-latency") {
+      options.input_latency = true;
+    } else if (arg == "--shm" && has_value) {
+      options.shm_name = argv[++i];
+    } else if (arg == "--break" && has_value) {
+      const auto address = Emulator::parse_number(argv[++i]);
+      if (!address.has_value()) {
+        std::cout << std::format("Invalid breakpoint: {}\n", argv[i]);
+        return 1;
+      }
+      options.breakpoints.push_back(address.value());
+    } else if (arg == "--watch" && has_value) {
+      const auto watchpoint = Emulator::parse_watchpoint(argv[++i]);
+      if (!watchpoint.has_value()) {
+        std::cout << std::format("Invalid watchpoint: {}\n", argv[i]);
+        return 1;
+      }
+      options.watchpoints.push_back(watchpoint.value());
+    } else if (arg == "--break-if" && has_value) {
+      const auto condition = Emulator::parse_condition(argv[++i]);
+      if (!condition.has_value()) {
+        std::cout << std::format("Invalid condition: {}\n", argv[i]);
+        return 1;
+      }
+      options.conditions.push_back(condition.value());
+    } else if (arg == "--lockstep" && has_value) {
+      const auto selected = Emulator::profile_from_name(argv[++i]);
+      if (!selected.has_value()) {
+        std::cout << std::format("Unknown profile: {}\n", argv[i]);
+        return 1;
+      }
+      options.lockstep_profile = selected.value();
+    } else if (arg == "--lockstep-interval" && has_value) {
+      options.lockstep_interval = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--palette" && has_value) {
+      const auto palette = Render::parse_palette(argv[++i]);
+      if (!palette.has_value()) {
+        std::cout << std::format("Invalid palette: {}\n", argv[i]);
+        return 1;
+      }
+      options.palette = palette.value();
+    } else if (arg == "--scanlines") {
+      options.scanlines = true;
+    } else if (arg == "--font" && has_value) {
+      options.font_path = argv[++i];
+#ifndef CHIP8_TTF
+      std::cout << "Built without SDL2_ttf, using the built-in font\n";
+#endif
+    } else if (arg == "--startup-profile") {
+      startup_profile.enabled = true;
+    } else {
+      options.game_name = arg;
+    }
+  }
+
+  if (!options.shm_name.empty()) {
+    return chip8_shm_serve(options.shm_name.data(),
+                           static_cast<int>(options.profile),
+                           options.game_name.data());
+  }
+
+  auto emulator = Emulator::make_emulator(options.profile);
+
+  if (options.lockstep_profile.has_value()) {
+    if (!options.headless_cycles.has_value()) {
+      std::cout << "--lockstep needs --headless cycles\n";
+      return 1;
+    }
+    auto candidate = Emulator::make_emulator(options.lockstep_profile.value());
+    return std::visit(
+        [&](auto &reference, auto &second) {
+          return run_lockstep(reference, second, options);
+        },
+        emulator, candidate);
+  }
+
+  if (options.headless_cycles.has_value()) {
+    return std::visit(
+        [&](auto &core) { return run_headless(core, options); }, emulator);
+  }
+
+  Context context(options.game_name, WINDOW_WIDTH, WINDOW_HEIGHT);
+  context.font_path = options.font_path;
+  startup_profile.mark("window");
+
+  const auto result = std::visit(
+      [&](auto &core) { return run(context, core, options, startup_profile); },
+      emulator);
+
+  SDL_Quit();
+
+  return result;
+}
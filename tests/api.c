@@ -0,0 +1,147 @@
+/* Drives libchip8 through CHIP8_API.h the way an agent would: an in-process
+ * emulator, then served ones in a child process that are stepped and told to
+ * quit straight away, which hangs if the server misses the QUIT request.
+ *
+ * usage: chip8_api [rounds]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "CHIP8_API.h"
+
+/* 200: LD V0, 05
+ * 202: ADD V0, 01
+ * 204: JP 202 */
+static const uint8_t counter_rom[] = {0x60, 0x05, 0x70, 0x01, 0x12, 0x02};
+
+/* 200: EXIT */
+static const uint8_t halt_rom[] = {0x00, 0x00};
+
+static int failed = 0;
+
+static void check(const int condition, const char *what) {
+  if (!condition) {
+    printf("FAIL %s\n", what);
+    failed = 1;
+  }
+}
+
+/* cycles run_headless has executed after `frames` timer ticks */
+static uint64_t headless_cycles(const unsigned frames) {
+  const double cycles_per_tick = 400 / 60.0;
+  double next_tick = 0;
+  uint64_t cycle = 0;
+  for (unsigned frame = 0; frame < frames; ++frame) {
+    next_tick += cycles_per_tick;
+    while ((double)cycle < next_tick) {
+      ++cycle;
+    }
+  }
+  return cycle;
+}
+
+static void in_process(void) {
+  struct chip8_shm *shm =
+      chip8_create(CHIP8_PROFILE_MODERN, counter_rom, sizeof(counter_rom));
+  check(shm != NULL, "chip8_create");
+  if (shm == NULL) {
+    return;
+  }
+
+  /* 7 + 7 + 6: one LD, then 10 ADDs and 9 JPs */
+  check(chip8_step(shm, 3, 0) == CHIP8_STATUS_OK, "step status");
+  check(shm->frame == 3 && shm->cycle == 20, "3 frames run 20 instructions");
+  check(chip8_registers(shm)[0] == 15, "V0 read in place");
+  check(chip8_memory(shm)[0x200] == 0x60, "memory read in place");
+
+  check(chip8_step(shm, 57, 0) == CHIP8_STATUS_OK, "step status");
+  check(shm->cycle == headless_cycles(60), "60 frames match --headless");
+
+  check(chip8_reset(shm) == CHIP8_STATUS_OK, "reset status");
+  check(shm->frame == 0 && shm->cycle == 0 && chip8_registers(shm)[0] == 0,
+        "reset reloads the ROM");
+  check(chip8_quit(shm) == CHIP8_STATUS_OK, "in-process quit");
+  chip8_close(shm);
+
+  shm = chip8_create(CHIP8_PROFILE_MODERN, halt_rom, sizeof(halt_rom));
+  check(shm != NULL && chip8_step(shm, 1, 0) == CHIP8_STATUS_HALTED,
+        "0000 halts");
+  if (shm != NULL) {
+    chip8_close(shm);
+  }
+}
+
+static struct chip8_shm *attach(const char *name) {
+  const struct timespec delay = {0, 1000000};
+  for (int attempt = 0; attempt < 5000; ++attempt) {
+    struct chip8_shm *shm = chip8_shm_attach(name);
+    if (shm != NULL) {
+      return shm;
+    }
+    nanosleep(&delay, NULL);
+  }
+  return NULL;
+}
+
+static void served(const char *rom_path, const unsigned round) {
+  char name[64];
+  snprintf(name, sizeof(name), "/chip8-api-test-%ld-%u", (long)getpid(), round);
+
+  const pid_t server = fork();
+  if (server == 0) {
+    fclose(stdout);
+    _exit(chip8_shm_serve(name, CHIP8_PROFILE_MODERN, rom_path));
+  }
+
+  struct chip8_shm *shm = attach(name);
+  check(shm != NULL, "chip8_shm_attach");
+  if (shm == NULL) {
+    kill(server, SIGKILL);
+    waitpid(server, NULL, 0);
+    return;
+  }
+
+  /* QUIT lands right after STEP is answered */
+  check(chip8_step(shm, 3, 0) == CHIP8_STATUS_OK && shm->cycle == 20 &&
+            chip8_registers(shm)[0] == 15,
+        "served step");
+  check(chip8_quit(shm) == CHIP8_STATUS_OK, "served quit");
+  chip8_close(shm);
+
+  int status = 0;
+  waitpid(server, &status, 0);
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "server exit");
+}
+
+int main(int argc, char **argv) {
+  const unsigned rounds =
+      argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 1000;
+  /* a lost request blocks forever, fail instead */
+  alarm(60);
+
+  in_process();
+
+  char rom_path[] = "/tmp/chip8-api-test-XXXXXX";
+  const int fd = mkstemp(rom_path);
+  check(fd >= 0 && write(fd, counter_rom, sizeof(counter_rom)) ==
+                       (ssize_t)sizeof(counter_rom),
+        "write ROM");
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  for (unsigned round = 0; round < rounds && !failed; ++round) {
+    served(rom_path, round);
+  }
+  unlink(rom_path);
+
+  printf("%s\n", failed ? "FAILED" : "PASSED");
+  return failed;
+}
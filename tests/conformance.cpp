@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "CHIP8.hpp"
+#include "Hash.hpp"
+#include "config.hpp"
+#include "test_roms.hpp"
+
+// Runs every case headless for a fixed number of cycles and compares a hash
+// of the framebuffer and one of the machine state against
+// <golden dir>/<case>.txt, so any core has to match the reference bit for bit.
+//
+// usage: chip8_conformance --golden dir [--rom-dir dir] [--shard i/n]
+//                          [--update] [case...]
+
+namespace {
+// CTest's SKIP_RETURN_CODE, every selected case was skipped
+constexpr int SKIPPED = 77;
+
+struct KeyEvent {
+  uint64_t cycle;
+  uint16_t keys;
+};
+
+struct Case {
+  std::string_view name;
+  Emulator::Profile profile;
+  std::span<const uint8_t> rom;
+  // a community test ROM looked up in --rom-dir instead of an embedded one
+  std::string_view rom_file;
+  uint64_t cycles;
+  std::span<const KeyEvent> key_script;
+};
+
+// press A and release it for FX0A, then hold 5 for EX9E/EXA1
+constexpr std::array keypad_script = {
+    KeyEvent{200, 1 << 0xA}, KeyEvent{400, 0}, KeyEvent{600, 1 << 0x5},
+    KeyEvent{800, 0}};
+
+// the menus of the chip8-test-suite ROMs wait for a key
+constexpr std::array menu_chip8 = {KeyEvent{2000, 1 << 0x1},
+                                   KeyEvent{2400, 0}};
+constexpr std::array menu_schip = {KeyEvent{2000, 1 << 0x2},
+                                   KeyEvent{2400, 0}};
+constexpr std::array menu_xochip = {KeyEvent{2000, 1 << 0x3},
+                                    KeyEvent{2400, 0}};
+
+using Emulator::Profile;
+
+const std::array cases = {
+    Case{"opcodes", Profile::Modern, Tests::opcodes_rom, {}, 10000, {}},
+    Case{"quirks.modern", Profile::Modern, Tests::quirks_rom, {}, 2000, {}},
+    Case{"quirks.chip8", Profile::CHIP8, Tests::quirks_rom, {}, 2000, {}},
+    Case{"quirks.schip", Profile::SuperChip, Tests::quirks_rom, {}, 2000, {}},
+    Case{"quirks.xochip", Profile::XOChip, Tests::quirks_rom, {}, 2000, {}},
+    Case{"keypad", Profile::Modern, Tests::keypad_rom, {}, 2000, keypad_script},
+    Case{"schip", Profile::SuperChip, Tests::schip_rom, {}, 2000, {}},
+    Case{"xochip", Profile::XOChip, Tests::xochip_rom, {}, 2000, {}},
+    Case{"unknown", Profile::Modern, Tests::unknown_rom, {}, 100, {}},
+    Case{"unknown.system", Profile::SuperChip, Tests::unknown_system_rom, {},
+         100, {}},
+    // Timendus' chip8-test-suite, only run when --rom-dir has them
+    Case{"suite.chip8-logo", Profile::CHIP8, {}, "1-chip8-logo.ch8", 1000, {}},
+    Case{"suite.ibm-logo", Profile::CHIP8, {}, "2-ibm-logo.ch8", 1000, {}},
+    Case{"suite.corax", Profile::CHIP8, {}, "3-corax+.ch8", 4000, {}},
+    Case{"suite.flags", Profile::CHIP8, {}, "4-flags.ch8", 8000, {}},
+    Case{"suite.quirks.chip8", Profile::CHIP8, {}, "5-quirks.ch8", 60000,
+         menu_chip8},
+    Case{"suite.quirks.schip", Profile::SuperChip, {}, "5-quirks.ch8", 60000,
+         menu_schip},
+    Case{"suite.quirks.xochip", Profile::XOChip, {}, "5-quirks.ch8", 60000,
+         menu_xochip},
+    Case{"suite.keypad", Profile::CHIP8, {}, "6-keypad.ch8", 4000, menu_chip8},
+    Case{"suite.scrolling", Profile::SuperChip, {}, "8-scrolling.ch8", 20000,
+         menu_schip},
+};
+
+struct Hashes {
+  uint64_t framebuffer;
+  uint64_t state;
+
+  bool operator==(const Hashes &) const = default;
+};
+
+// FNV-1a, fed byte by byte so the hashes don't depend on the host
+Hashes hash(const auto &emulator, const bool halted) {
+  const auto &display = emulator.display();
+  Emulator::Fnv1a framebuffer;
+  framebuffer.add(display.hires());
+  for (std::size_t plane = 0; plane < Emulator::Display::PLANES; ++plane) {
+    for (std::size_t y = 0; y < Emulator::Display::MAX_HEIGHT; ++y) {
+      const auto row = display.row(plane, y);
+      for (std::size_t byte = 0; byte < sizeof(row); ++byte) {
+        framebuffer.add(static_cast<uint8_t>(row >> (byte * 8)));
+      }
+    }
+  }
+
+  const auto &state = emulator.state();
+  Emulator::Fnv1a machine;
+  machine.add(state.memory);
+  machine.add(state.registers);
+  machine.add(state.rpl_flags);
+  machine.add(state.audio_pattern);
+  machine.add_le(static_cast<uint64_t>(state.stack.size()));
+  for (const auto address : state.stack.entries()) {
+    machine.add_le(address);
+  }
+  machine.add_le(static_cast<uint64_t>(state.index_register));
+  machine.add_le(state.program_counter);
+  machine.add(state.delay_timer);
+  machine.add(state.sound_timer);
+  machine.add(state.pitch);
+  machine.add(state.plane_mask);
+  machine.add(static_cast<uint8_t>(state.fault));
+  machine.add_le(emulator.cycle_count());
+  machine.add(halted);
+
+  return {framebuffer.value(), machine.value()};
+}
+
+// same clocking as the headless mode: a timer tick every 1/60 s of cycles
+Hashes run(auto &emulator, const Case &test, std::span<const uint8_t> rom) {
+  emulator.load_rom(rom);
+
+  constexpr auto cycles_per_tick = Emulator::PROCESSOR_SPEED / 60.0;
+  double next_tick = 0;
+  auto next_key = test.key_script.begin();
+  bool halted = false;
+
+  while (emulator.cycle_count() < test.cycles) {
+    const auto cycle = emulator.cycle_count();
+    if (static_cast<double>(cycle) >= next_tick) {
+      next_tick += cycles_per_tick;
+      emulator.timer_tick();
+    }
+    for (; next_key != test.key_script.end() && next_key->cycle <= cycle;
+         ++next_key) {
+      emulator.set_keys(next_key->keys);
+    }
+
+    if (!emulator.single_step()) {
+      halted = true;
+      break;
+    }
+  }
+
+  return hash(emulator, halted);
+}
+
+void print_screen(const auto &emulator) {
+  const auto &display = emulator.display();
+  for (std::size_t y = 0; y < display.height(); ++y) {
+    std::string line;
+    for (std::size_t x = 0; x < display.width(); ++x) {
+      line += " #+*"[display.pixel(x, y)];
+    }
+    std::cout << std::format("  |{}|\n", line);
+  }
+
+  const auto &state = emulator.state();
+  std::string registers;
+  for (std::size_t i = 0; i < state.registers.size(); ++i) {
+    registers += std::format(" V{:X}={:02X}", i, state.registers[i]);
+  }
+  std::cout << std::format("  PC={:03X} I={:03X} fault={} cycles={}\n ",
+                           state.program_counter, state.index_register,
+                           static_cast<unsigned>(state.fault),
+                           emulator.cycle_count())
+            << registers << '\n';
+}
+
+std::optional<Hashes> read_golden(const std::string &filename) {
+  std::ifstream file(filename);
+  std::string framebuffer_label, state_label;
+  Hashes hashes{};
+  if (!(file >> framebuffer_label >> std::hex >> hashes.framebuffer >>
+        state_label >> hashes.state) ||
+      framebuffer_label != "framebuffer" || state_label != "state") {
+    return std::nullopt;
+  }
+  return hashes;
+}
+
+bool write_golden(const std::string &filename, const Hashes &hashes) {
+  std::ofstream file(filename);
+  file << std::format("framebuffer {:016x}\nstate {:016x}\n",
+                      hashes.framebuffer, hashes.state);
+  return file.good();
+}
+
+std::vector<uint8_t> read_file(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+struct Options {
+  std::string golden_dir = "tests/golden";
+  std::string rom_dir;
+  std::size_t shard = 0;
+  std::size_t shard_count = 1;
+  bool update = false;
+  std::vector<std::string_view> names;
+};
+
+enum class Outcome { Passed, Failed, Skipped };
+
+Outcome run_case(const Case &test, const Options &options) {
+  std::vector<uint8_t> rom_file;
+  auto rom = test.rom;
+  if (!test.rom_file.empty()) {
+    if (!options.rom_dir.empty()) {
+      rom_file = read_file(std::format("{}/{}", options.rom_dir, test.rom_file));
+    }
+    if (rom_file.empty()) {
+      std::cout << std::format("SKIP {}: {} not found, set --rom-dir\n",
+                               test.name, test.rom_file);
+      return Outcome::Skipped;
+    }
+    rom = rom_file;
+  }
+
+  auto emulator = Emulator::make_emulator(test.profile);
+  const auto actual = std::visit(
+      [&](auto &core) { return run(core, test, rom); }, emulator);
+  const auto golden_file = std::format("{}/{}.txt", options.golden_dir, test.name);
+
+  if (options.update) {
+    if (!write_golden(golden_file, actual)) {
+      std::cout << std::format("FAIL {}: could not write {}\n", test.name,
+                               golden_file);
+      return Outcome::Failed;
+    }
+    std::cout << std::format("UPDATED {}\n", test.name);
+    std::visit([](const auto &core) { print_screen(core); }, emulator);
+    return Outcome::Passed;
+  }
+
+  const auto expected = read_golden(golden_file);
+  if (!expected.has_value()) {
+    std::cout << std::format("SKIP {}: no golden hashes, review a run with "
+                             "--update\n",
+                             test.name);
+    return Outcome::Skipped;
+  }
+
+  if (actual != expected.value()) {
+    std::cout << std::format(
+        "FAIL {}: framebuffer {:016x} (expected {:016x}), state {:016x} "
+        "(expected {:016x})\n",
+        test.name, actual.framebuffer, expected->framebuffer, actual.state,
+        expected->state);
+    std::visit([](const auto &core) { print_screen(core); }, emulator);
+    return Outcome::Failed;
+  }
+
+  std::cout << std::format("PASS {}\n", test.name);
+  return Outcome::Passed;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--golden" && has_value) {
+      options.golden_dir = argv[++i];
+    } else if (arg == "--rom-dir" && has_value) {
+      options.rom_dir = argv[++i];
+    } else if (arg == "--shard" && has_value) {
+      const std::string_view shard = argv[++i];
+      const auto slash = shard.find('/');
+      options.shard = std::strtoul(std::string(shard.substr(0, slash)).c_str(),
+                                   nullptr, 10);
+      options.shard_count =
+          slash == std::string_view::npos
+              ? 1
+              : std::strtoul(std::string(shard.substr(slash + 1)).c_str(),
+                             nullptr, 10);
+      if (options.shard_count == 0 || options.shard >= options.shard_count) {
+        std::cout << std::format("Invalid shard: {}\n", shard);
+        return 1;
+      }
+    } else if (arg == "--update") {
+      options.update = true;
+    } else if (arg == "--list") {
+      for (const auto &test : cases) {
+        std::cout << test.name << '\n';
+      }
+      return 0;
+    } else {
+      options.names.push_back(arg);
+    }
+  }
+
+  std::size_t passed = 0, failed = 0, skipped = 0;
+
+  for (std::size_t i = 0; i < cases.size(); ++i) {
+    const auto &test = cases[i];
+    if (options.names.empty() ? i % options.shard_count != options.shard
+                              : std::ranges::find(options.names, test.name) ==
+                                    options.names.end()) {
+      continue;
+    }
+
+    switch (run_case(test, options)) {
+    case Outcome::Passed:
+      ++passed;
+      break;
+    case Outcome::Failed:
+      ++failed;
+      break;
+    case Outcome::Skipped:
+      ++skipped;
+      break;
+    }
+  }
+
+  std::cout << std::format("{} passed, {} failed, {} skipped\n", passed,
+                           failed, skipped);
+
+  if (failed > 0) {
+    return 1;
+  }
+  return passed == 0 && skipped > 0 ? SKIPPED : 0;
+}
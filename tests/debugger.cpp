@@ -0,0 +1,191 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <initializer_list>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+#include "CHIP8.hpp"
+#include "Debugger.hpp"
+#include "config.hpp"
+
+// Runs small programs under the debugger and checks where each kind of trap
+// stops them, including breakpoints the cached block lookup could step past.
+//
+// usage: chip8_debugger
+
+namespace {
+using Modern = Emulator::CHIP8<Emulator::Quirks::Modern>;
+using Emulator::Stop;
+
+// 200: LD V0, 00
+// 202: ADD V0, 01
+// 204: ADD V0, 01
+// 206: ADD V0, 01
+// 208: JP 200
+constexpr std::array<uint8_t, 10> straight_rom = {0x60, 0x00, 0x70, 0x01, 0x70,
+                                                  0x01, 0x70, 0x01, 0x12, 0x00};
+
+// 200: LD V0, 00
+// 202: CALL 210
+// 204: ADD V0, 01
+// 206: LD I, 300
+// 208: LD [I], V0
+// 20A: JP 202
+// 210: LD V1, 05
+// 212: ADD V1, 01
+// 214: RET
+constexpr std::array<uint8_t, 22> call_rom = {
+    0x60, 0x00, 0x22, 0x10, 0x70, 0x01, 0xA3, 0x00, 0xF0, 0x55, 0x12,
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x61, 0x05, 0x71, 0x01, 0x00, 0xEE};
+
+constexpr std::size_t STEP_LIMIT = 1000;
+
+Stop run(Emulator::Debugger<Modern> &debugger) {
+  for (std::size_t i = 0; i < STEP_LIMIT; ++i) {
+    if (const auto stop = debugger.step(); stop != Stop::None) {
+      return stop;
+    }
+  }
+  return Stop::None;
+}
+
+bool check(const std::string_view name, const Modern &emulator,
+           const Stop actual, const Stop expected,
+           const uint16_t program_counter) {
+  const auto actual_pc = emulator.state().program_counter;
+  if (actual != expected || actual_pc != program_counter) {
+    std::cout << std::format("FAIL {}: stop {} at 0x{:03X}, expected stop {} "
+                             "at 0x{:03X}\n",
+                             name, static_cast<unsigned>(actual), actual_pc,
+                             static_cast<unsigned>(expected), program_counter);
+    return false;
+  }
+  std::cout << std::format("PASS {}\n", name);
+  return true;
+}
+
+bool check(const std::string_view name, const bool condition) {
+  std::cout << std::format("{} {}\n", condition ? "PASS" : "FAIL", name);
+  return condition;
+}
+
+std::size_t breakpoints() {
+  std::size_t failed = 0;
+
+  // 0x203 is never reached, the breakpoint after it still has to fire
+  for (const auto &[name, odd] :
+       {std::pair{"breakpoint", false}, std::pair{"breakpoint.passed", true}}) {
+    Modern emulator;
+    emulator.load_rom(straight_rom);
+    Emulator::Debugger debugger(emulator);
+    if (odd) {
+      debugger.add_breakpoint(0x203);
+    }
+    debugger.add_breakpoint(0x206);
+    failed += !check(name, emulator, run(debugger), Stop::Breakpoint, 0x206);
+
+    // one lap of the loop later it stops at the same place
+    debugger.resume();
+    failed += !check(std::format("{}.resume", name), emulator, run(debugger),
+                     Stop::Breakpoint, 0x206);
+    failed += !check(std::format("{}.lap", name), emulator.cycle_count() == 8);
+  }
+
+  {
+    Modern emulator;
+    emulator.load_rom(straight_rom);
+    Emulator::Debugger debugger(emulator);
+    debugger.toggle_breakpoint(0x204);
+    debugger.toggle_breakpoint(0x204);
+    debugger.add_breakpoint(0x208);
+    failed += !check("breakpoint.toggled", emulator, run(debugger),
+                     Stop::Breakpoint, 0x208);
+  }
+  return failed;
+}
+
+std::size_t steps() {
+  std::size_t failed = 0;
+  Modern emulator;
+  emulator.load_rom(call_rom);
+  Emulator::Debugger debugger(emulator);
+
+  // not a CALL, so only one instruction
+  debugger.step_over();
+  failed += !check("step_over.plain", emulator, run(debugger), Stop::Step,
+                   0x202);
+  debugger.step_over();
+  failed += !check("step_over.call", emulator, run(debugger), Stop::Step,
+                   0x204);
+  failed += !check("step_over.ran", emulator.state().registers[1] == 6);
+
+  failed += !check("step_out.outside",
+                   !debugger.step_out() &&
+                       debugger.message() == "Not in a subroutine");
+
+  debugger.add_breakpoint(0x212);
+  debugger.resume();
+  failed += !check("step_out.breakpoint", emulator, run(debugger),
+                   Stop::Breakpoint, 0x212);
+  failed += !check("step_out.inside", emulator,
+                   debugger.step_out() ? run(debugger) : Stop::None,
+                   Stop::Step, 0x204);
+
+  debugger.step_into();
+  failed += !check("step_into", emulator, run(debugger), Stop::Step, 0x206);
+  return failed;
+}
+
+std::size_t watches() {
+  std::size_t failed = 0;
+
+  {
+    Modern emulator;
+    emulator.load_rom(call_rom);
+    Emulator::Debugger debugger(emulator);
+    debugger.add_watchpoint(*Emulator::parse_watchpoint("0x300:w"));
+    // trapped before F055 writes V0 = 1
+    failed += !check("watchpoint", emulator, run(debugger), Stop::Watchpoint,
+                     0x208);
+    failed += !check("watchpoint.before",
+                     emulator.state().memory[0x300] == 0);
+    debugger.resume();
+    failed += !check("watchpoint.resume", emulator, run(debugger),
+                     Stop::Watchpoint, 0x208);
+  }
+
+  {
+    Modern emulator;
+    emulator.load_rom(call_rom);
+    Emulator::Debugger debugger(emulator);
+    debugger.add_watchpoint(*Emulator::parse_watchpoint("0x300:r"));
+    debugger.add_breakpoint(0x20A);
+    failed += !check("watchpoint.read_only", emulator, run(debugger),
+                     Stop::Breakpoint, 0x20A);
+  }
+
+  {
+    Modern emulator;
+    emulator.load_rom(call_rom);
+    Emulator::Debugger debugger(emulator);
+    debugger.add_condition(*Emulator::parse_condition("V0==2"));
+    // trapped after the ADD that makes it true, only once
+    failed += !check("condition", emulator, run(debugger), Stop::Condition,
+                     0x206);
+    debugger.add_breakpoint(0x204);
+    debugger.resume();
+    failed += !check("condition.held", emulator, run(debugger),
+                     Stop::Breakpoint, 0x204);
+  }
+  return failed;
+}
+} // namespace
+
+int main() {
+  const auto failed = breakpoints() + steps() + watches();
+  std::cout << std::format("{} failed\n", failed);
+  return failed > 0 ? 1 : 0;
+}
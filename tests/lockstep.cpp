@@ -0,0 +1,162 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "CHIP8.hpp"
+#include "Lockstep.hpp"
+#include "config.hpp"
+#include "test_roms.hpp"
+
+// Checks that the lock-step validator stays quiet for identical cores and
+// bisects to the exact instruction for differing ones, whatever the interval.
+//
+// usage: chip8_lockstep
+
+namespace {
+using Modern = Emulator::CHIP8<Emulator::Quirks::Modern>;
+using Original = Emulator::CHIP8<Emulator::Quirks::CHIP8>;
+
+// stands in for a broken optimised core: drops one instruction, here the
+// JP of the wait_release loop while 5 is held
+class SkipsInstruction : public Modern {
+public:
+  explicit SkipsInstruction(const uint64_t skipped) : m_skipped(skipped) {}
+
+  bool single_step() {
+    if (m_steps++ == m_skipped) {
+      return true;
+    }
+    return Modern::single_step();
+  }
+
+private:
+  uint64_t m_skipped;
+  uint64_t m_steps{};
+};
+
+// 200: ADD V0, 01
+// 202: JP 200
+constexpr std::array<uint8_t, 4> loop_rom = {0x70, 0x01, 0x12, 0x00};
+
+// 200: LD I, 300
+// 202: LD V1, 01
+// 204: ADD V0, 01
+// 206: LD [I], V0
+// 208: ADD I, V1
+// 20A: JP 204
+constexpr std::array<uint8_t, 12> store_rom = {
+    0xA3, 0x00, 0x61, 0x01, 0x70, 0x01, 0xF0, 0x55, 0xF1, 0x1E, 0x12, 0x04};
+
+constexpr std::array intervals = {uint64_t{1}, uint64_t{7}, uint64_t{64},
+                                  uint64_t{1000}};
+
+// press and release A, then hold 5, like the keypad conformance case
+constexpr uint16_t keys_at(const uint64_t cycle) {
+  if (cycle >= 200 && cycle < 400) {
+    return 1 << 0xA;
+  }
+  if (cycle >= 600 && cycle < 800) {
+    return 1 << 0x5;
+  }
+  return 0;
+}
+
+std::optional<Emulator::Divergence> run(auto reference, auto candidate,
+                                        std::span<const uint8_t> rom,
+                                        const uint64_t cycles,
+                                        const uint64_t interval) {
+  reference.load_rom(rom);
+  candidate.load_rom(rom);
+  Emulator::Lockstep lockstep(reference, candidate, interval);
+
+  constexpr auto cycles_per_tick = Emulator::PROCESSOR_SPEED / 60.0;
+  double next_tick = 0;
+  while (lockstep.cycle_count() < cycles) {
+    if (static_cast<double>(lockstep.cycle_count()) >= next_tick) {
+      next_tick += cycles_per_tick;
+      lockstep.timer_tick();
+    }
+    lockstep.set_keys(keys_at(lockstep.cycle_count()));
+    if (!lockstep.single_step()) {
+      break;
+    }
+  }
+  lockstep.verify();
+  return lockstep.divergence();
+}
+
+struct Expected {
+  uint64_t cycle;
+  uint32_t program_counter;
+  uint16_t opcode;
+};
+
+bool check(const std::string_view name,
+           const std::optional<Emulator::Divergence> &actual,
+           const std::optional<Expected> &expected) {
+  if (!expected.has_value()) {
+    if (actual.has_value()) {
+      std::cout << std::format("FAIL {}: diverged after {} at 0x{:03x}: {}\n",
+                               name, actual->cycle, actual->program_counter,
+                               actual->differences);
+      return false;
+    }
+  } else if (!actual.has_value()) {
+    std::cout << std::format("FAIL {}: no divergence found\n", name);
+    return false;
+  } else if (actual->cycle != expected->cycle ||
+             actual->program_counter != expected->program_counter ||
+             actual->opcode != expected->opcode) {
+    std::cout << std::format(
+        "FAIL {}: diverged after {} at 0x{:03x} ({:04X}), expected {} at "
+        "0x{:03x} ({:04X})\n",
+        name, actual->cycle, actual->program_counter, actual->opcode,
+        expected->cycle, expected->program_counter, expected->opcode);
+    return false;
+  }
+  std::cout << std::format("PASS {}\n", name);
+  return true;
+}
+} // namespace
+
+int main() {
+  std::size_t failed = 0;
+
+  for (const auto interval : intervals) {
+    failed += !check(std::format("identical.opcodes/{}", interval),
+                     run(Modern{}, Modern{}, Tests::opcodes_rom, 10000,
+                         interval),
+                     std::nullopt);
+    failed += !check(std::format("identical.keypad/{}", interval),
+                     run(Modern{}, Modern{}, Tests::keypad_rom, 2000,
+                         interval),
+                     std::nullopt);
+    // 8126 shifts V2 into V1 on the COSMAC VIP
+    failed += !check(std::format("profiles.quirks/{}", interval),
+                     run(Modern{}, Original{}, Tests::quirks_rom, 2000,
+                         interval),
+                     Expected{2, 0x204, 0x8126});
+    failed += !check(std::format("skipped.keypad/{}", interval),
+                     run(Modern{}, SkipsInstruction{700}, Tests::keypad_rom,
+                         2000, interval),
+                     Expected{700, 0x216, 0x1212});
+    // past the first checkpoint, the replay starts from a later copy
+    failed += !check(std::format("skipped.loop/{}", interval),
+                     run(Modern{}, SkipsInstruction{6001}, loop_rom, 10000,
+                         interval),
+                     Expected{6001, 0x202, 0x1200});
+    // registers stay equal, only the memory hash at a checkpoint sees it
+    failed += !check(std::format("skipped.store/{}", interval),
+                     run(Modern{}, SkipsInstruction{5003}, store_rom, 10000,
+                         interval),
+                     Expected{5003, 0x206, 0xF055});
+  }
+
+  std::cout << std::format("{} failed\n", failed);
+  return failed > 0 ? 1 : 0;
+}
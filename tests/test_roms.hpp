@@ -0,0 +1,426 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// ROMs for the conformance suite, listed with their source. In the self
+// checking ones every check loads its number into VE and jumps to fail if the
+// result is wrong; fail draws that number, pass draws a single 0. The others
+// are judged by their golden hashes alone. All of them end with 0000.
+
+namespace Tests {
+// instruction semantics and VF results
+constexpr std::array<uint8_t, 438> opcodes_rom = {
+    0x60, 0x12,                // ld v0, 0x12
+    0x6E, 0x01,                // ld ve, 1
+    0x30, 0x12,                // se v0, 0x12
+    0x13, 0x98,                // jp fail
+    0x6F, 0x55,                // ld vf, 0x55
+    0x70, 0xF0,                // add v0, 0xF0
+    0x6E, 0x02,                // ld ve, 2
+    0x30, 0x02,                // se v0, 0x02
+    0x13, 0x98,                // jp fail
+    0x6E, 0x03,                // ld ve, 3
+    0x3F, 0x55,                // se vf, 0x55
+    0x13, 0x98,                // jp fail
+    0x6E, 0x04,                // ld ve, 4
+    0x30, 0x02,                // se v0, 0x02
+    0x13, 0x98,                // jp fail
+    0x6E, 0x05,                // ld ve, 5
+    0x40, 0x03,                // sne v0, 0x03
+    0x13, 0x98,                // jp fail
+    0x6E, 0x06,                // ld ve, 6
+    0x30, 0x03,                // se v0, 0x03
+    0x12, 0x2C,                // jp 0x22C
+    0x13, 0x98,                // jp fail
+    0x6E, 0x07,                // ld ve, 7
+    0x40, 0x02,                // sne v0, 0x02
+    0x12, 0x34,                // jp 0x234
+    0x13, 0x98,                // jp fail
+    0x61, 0x02,                // ld v1, 0x02
+    0x6E, 0x08,                // ld ve, 8
+    0x50, 0x10,                // se v0, v1
+    0x13, 0x98,                // jp fail
+    0x6E, 0x09,                // ld ve, 9
+    0x90, 0x10,                // sne v0, v1
+    0x12, 0x44,                // jp 0x244
+    0x13, 0x98,                // jp fail
+    0x61, 0x03,                // ld v1, 0x03
+    0x6E, 0x0A,                // ld ve, 10
+    0x90, 0x10,                // sne v0, v1
+    0x13, 0x98,                // jp fail
+    0x6E, 0x0B,                // ld ve, 11
+    0x50, 0x10,                // se v0, v1
+    0x12, 0x54,                // jp 0x254
+    0x13, 0x98,                // jp fail
+    0x60, 0xF0,                // ld v0, 0xF0
+    0x61, 0x3C,                // ld v1, 0x3C
+    0x82, 0x00,                // ld v2, v0
+    0x82, 0x11,                // or v2, v1
+    0x6E, 0x0C,                // ld ve, 12
+    0x32, 0xFC,                // se v2, 0xFC
+    0x13, 0x98,                // jp fail
+    0x82, 0x00,                // ld v2, v0
+    0x82, 0x12,                // and v2, v1
+    0x6E, 0x0D,                // ld ve, 13
+    0x32, 0x30,                // se v2, 0x30
+    0x13, 0x98,                // jp fail
+    0x82, 0x00,                // ld v2, v0
+    0x82, 0x13,                // xor v2, v1
+    0x6E, 0x0E,                // ld ve, 14
+    0x32, 0xCC,                // se v2, 0xCC
+    0x13, 0x98,                // jp fail
+    0x62, 0xF0,                // ld v2, 0xF0
+    0x82, 0x14,                // add v2, v1
+    0x6E, 0x0F,                // ld ve, 15
+    0x32, 0x2C,                // se v2, 0x2C
+    0x13, 0x98,                // jp fail
+    0x6E, 0x10,                // ld ve, 16
+    0x3F, 0x01,                // se vf, 1
+    0x13, 0x98,                // jp fail
+    0x62, 0x10,                // ld v2, 0x10
+    0x82, 0x14,                // add v2, v1
+    0x6E, 0x11,                // ld ve, 17
+    0x32, 0x4C,                // se v2, 0x4C
+    0x13, 0x98,                // jp fail
+    0x6E, 0x12,                // ld ve, 18
+    0x3F, 0x00,                // se vf, 0
+    0x13, 0x98,                // jp fail
+    0x62, 0x3C,                // ld v2, 0x3C
+    0x82, 0x05,                // sub v2, v0
+    0x6E, 0x13,                // ld ve, 19
+    0x32, 0x4C,                // se v2, 0x4C
+    0x13, 0x98,                // jp fail
+    0x6E, 0x14,                // ld ve, 20
+    0x3F, 0x00,                // se vf, 0
+    0x13, 0x98,                // jp fail
+    0x62, 0xF0,                // ld v2, 0xF0
+    0x82, 0x15,                // sub v2, v1
+    0x6E, 0x15,                // ld ve, 21
+    0x32, 0xB4,                // se v2, 0xB4
+    0x13, 0x98,                // jp fail
+    0x6E, 0x16,                // ld ve, 22
+    0x3F, 0x01,                // se vf, 1
+    0x13, 0x98,                // jp fail
+    0x62, 0x3C,                // ld v2, 0x3C
+    0x82, 0x07,                // subn v2, v0
+    0x6E, 0x17,                // ld ve, 23
+    0x32, 0xB4,                // se v2, 0xB4
+    0x13, 0x98,                // jp fail
+    0x6E, 0x18,                // ld ve, 24
+    0x3F, 0x01,                // se vf, 1
+    0x13, 0x98,                // jp fail
+    0x62, 0xF0,                // ld v2, 0xF0
+    0x82, 0x17,                // subn v2, v1
+    0x6E, 0x19,                // ld ve, 25
+    0x32, 0x4C,                // se v2, 0x4C
+    0x13, 0x98,                // jp fail
+    0x6E, 0x1A,                // ld ve, 26
+    0x3F, 0x00,                // se vf, 0
+    0x13, 0x98,                // jp fail
+    0x62, 0x05,                // ld v2, 0x05
+    0x82, 0x26,                // shr v2, v2
+    0x6E, 0x1B,                // ld ve, 27
+    0x32, 0x02,                // se v2, 0x02
+    0x13, 0x98,                // jp fail
+    0x6E, 0x1C,                // ld ve, 28
+    0x3F, 0x01,                // se vf, 1
+    0x13, 0x98,                // jp fail
+    0x62, 0x81,                // ld v2, 0x81
+    0x82, 0x2E,                // shl v2, v2
+    0x6E, 0x1D,                // ld ve, 29
+    0x32, 0x02,                // se v2, 0x02
+    0x13, 0x98,                // jp fail
+    0x6E, 0x1E,                // ld ve, 30
+    0x3F, 0x01,                // se vf, 1
+    0x13, 0x98,                // jp fail
+    0x6F, 0xFF,                // ld vf, 0xFF
+    0x63, 0x01,                // ld v3, 0x01
+    0x8F, 0x34,                // add vf, v3
+    0x6E, 0x1F,                // ld ve, 31
+    0x3F, 0x01,                // se vf, 1
+    0x13, 0x98,                // jp fail
+    0x23, 0x8A,                // call subroutine
+    0x6E, 0x20,                // ld ve, 32
+    0x34, 0x77,                // se v4, 0x77
+    0x13, 0x98,                // jp fail
+    0x60, 0x04,                // ld v0, 4
+    0xB3, 0x0E,                // jp v0, jumped - 4
+    0x6E, 0x21,                // ld ve, 33
+    0x13, 0x98,                // jp fail
+    // jumped:
+    0x65, 0xDB,                // ld v5, 219
+    0xA3, 0xAE,                // ld i, scratch
+    0xF5, 0x33,                // ld b, v5
+    0xF2, 0x65,                // ld v2, [i]
+    0x6E, 0x22,                // ld ve, 34
+    0x30, 0x02,                // se v0, 2
+    0x13, 0x98,                // jp fail
+    0x6E, 0x23,                // ld ve, 35
+    0x31, 0x01,                // se v1, 1
+    0x13, 0x98,                // jp fail
+    0x6E, 0x24,                // ld ve, 36
+    0x32, 0x09,                // se v2, 9
+    0x13, 0x98,                // jp fail
+    0x60, 0xA1,                // ld v0, 0xA1
+    0x61, 0xB2,                // ld v1, 0xB2
+    0x62, 0xC3,                // ld v2, 0xC3
+    0xF2, 0x55,                // ld [i], v2
+    0x60, 0x00,                // ld v0, 0
+    0x61, 0x00,                // ld v1, 0
+    0x62, 0x00,                // ld v2, 0
+    0xF2, 0x65,                // ld v2, [i]
+    0x6E, 0x25,                // ld ve, 37
+    0x30, 0xA1,                // se v0, 0xA1
+    0x13, 0x98,                // jp fail
+    0x6E, 0x26,                // ld ve, 38
+    0x31, 0xB2,                // se v1, 0xB2
+    0x13, 0x98,                // jp fail
+    0x6E, 0x27,                // ld ve, 39
+    0x32, 0xC3,                // se v2, 0xC3
+    0x13, 0x98,                // jp fail
+    0xF0, 0x65,                // ld v0, [i]
+    0x6E, 0x28,                // ld ve, 40
+    0x30, 0xA1,                // se v0, 0xA1
+    0x13, 0x98,                // jp fail
+    0x66, 0x01,                // ld v6, 1
+    0xF6, 0x1E,                // add i, v6
+    0xF0, 0x65,                // ld v0, [i]
+    0x6E, 0x29,                // ld ve, 41
+    0x30, 0xB2,                // se v0, 0xB2
+    0x13, 0x98,                // jp fail
+    0x66, 0x0A,                // ld v6, 0xA
+    0xF6, 0x29,                // ld f, v6
+    0xF1, 0x65,                // ld v1, [i]
+    0x6E, 0x2A,                // ld ve, 42
+    0x30, 0xF0,                // se v0, 0xF0
+    0x13, 0x98,                // jp fail
+    0x6E, 0x2B,                // ld ve, 43
+    0x31, 0x90,                // se v1, 0x90
+    0x13, 0x98,                // jp fail
+    0x66, 0x3C,                // ld v6, 0x3C
+    0xF6, 0x15,                // ld dt, v6
+    0xF7, 0x07,                // ld v7, dt
+    0x6E, 0x2C,                // ld ve, 44
+    0x47, 0x00,                // sne v7, 0
+    0x13, 0x98,                // jp fail
+    0xC8, 0x00,                // rnd v8, 0x00
+    0x6E, 0x2D,                // ld ve, 45
+    0x38, 0x00,                // se v8, 0
+    0x13, 0x98,                // jp fail
+    0x13, 0x8E,                // jp pass
+    // subroutine:
+    0x64, 0x77,                // ld v4, 0x77
+    0x00, 0xEE,                // ret
+    // pass:
+    0x60, 0x00,                // ld v0, 0
+    0x61, 0x00,                // ld v1, 0
+    0xF0, 0x29,                // ld f, v0
+    0xD0, 0x15,                // drw v0, v1, 5
+    0x00, 0x00,                // halt
+    // fail:
+    0xA3, 0xAE,                // ld i, scratch
+    0xFE, 0x33,                // ld b, ve
+    0xF2, 0x65,                // ld v2, [i]
+    0x60, 0x00,                // ld v0, 0
+    0x63, 0x00,                // ld v3, 0
+    0xF1, 0x29,                // ld f, v1
+    0xD0, 0x35,                // drw v0, v3, 5
+    0x60, 0x05,                // ld v0, 5
+    0xF2, 0x29,                // ld f, v2
+    0xD0, 0x35,                // drw v0, v3, 5
+    0x00, 0x00,                // halt
+    // scratch:
+    0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, // db 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88
+};
+
+// records the quirk behaviour in V9-VD instead of checking it, run once per
+// profile
+constexpr std::array<uint8_t, 73> quirks_rom = {
+    0x61, 0x10,                // ld v1, 0x10
+    0x62, 0x03,                // ld v2, 0x03
+    0x81, 0x26,                // shr v1, v2
+    0x8A, 0x10,                // ld va, v1
+    0x61, 0x0F,                // ld v1, 0x0F
+    0x62, 0xF0,                // ld v2, 0xF0
+    0x6F, 0x05,                // ld vf, 5
+    0x81, 0x21,                // or v1, v2
+    0x8B, 0xF0,                // ld vb, vf
+    0xA2, 0x45,                // ld i, scratch
+    0x60, 0x99,                // ld v0, 0x99
+    0xF0, 0x55,                // ld [i], v0
+    0xF0, 0x65,                // ld v0, [i]
+    0x8C, 0x00,                // ld vc, v0
+    0x60, 0x3C,                // ld v0, 60
+    0x61, 0x1E,                // ld v1, 30
+    0x62, 0x08,                // ld v2, 8
+    0xF2, 0x29,                // ld f, v2
+    0xD0, 0x15,                // drw v0, v1, 5
+    0x8D, 0xF0,                // ld vd, vf
+    0x60, 0x00,                // ld v0, 0
+    0x62, 0x04,                // ld v2, 4
+    0xB2, 0x2E,                // jp v0, jump
+    // jump:
+    0x69, 0x01,                // ld v9, 1
+    0x12, 0x34,                // jp jumped
+    0x69, 0x02,                // ld v9, 2
+    // jumped:
+    0x60, 0x04,                // ld v0, 4
+    0x61, 0x04,                // ld v1, 4
+    0xA2, 0x40,                // ld i, glyph
+    0xD0, 0x15,                // drw v0, v1, 5
+    0xD0, 0x15,                // drw v0, v1, 5
+    0x00, 0x00,                // halt
+    // glyph:
+    0xFF, 0x81, 0x81, 0x81, 0xFF, // db 0xFF, 0x81, 0x81, 0x81, 0xFF
+    // scratch:
+    0x11, 0x22, 0x33, 0x44,    // db 0x11, 0x22, 0x33, 0x44
+};
+
+// FX0A, EX9E and EXA1 against the key script of the keypad case
+constexpr std::array<uint8_t, 82> keypad_rom = {
+    0xF1, 0x0A,                // ld v1, k
+    0x6E, 0x01,                // ld ve, 1
+    0x31, 0x0A,                // se v1, 0xA
+    0x12, 0x34,                // jp fail
+    0x62, 0x05,                // ld v2, 5
+    // wait_press:
+    0xE2, 0xA1,                // sknp v2
+    0x12, 0x10,                // jp pressed
+    0x12, 0x0A,                // jp wait_press
+    // pressed:
+    0x63, 0x01,                // ld v3, 1
+    // wait_release:
+    0xE2, 0x9E,                // skp v2
+    0x12, 0x18,                // jp released
+    0x12, 0x12,                // jp wait_release
+    // released:
+    0x62, 0x06,                // ld v2, 6
+    0x6E, 0x02,                // ld ve, 2
+    0xE2, 0x9E,                // skp v2
+    0x12, 0x22,                // jp 0x222
+    0x12, 0x34,                // jp fail
+    0x6E, 0x03,                // ld ve, 3
+    0xE2, 0xA1,                // sknp v2
+    0x12, 0x34,                // jp fail
+    0x12, 0x2A,                // jp pass
+    // pass:
+    0x60, 0x00,                // ld v0, 0
+    0x61, 0x00,                // ld v1, 0
+    0xF0, 0x29,                // ld f, v0
+    0xD0, 0x15,                // drw v0, v1, 5
+    0x00, 0x00,                // halt
+    // fail:
+    0xA2, 0x4A,                // ld i, scratch
+    0xFE, 0x33,                // ld b, ve
+    0xF2, 0x65,                // ld v2, [i]
+    0x60, 0x00,                // ld v0, 0
+    0x63, 0x00,                // ld v3, 0
+    0xF1, 0x29,                // ld f, v1
+    0xD0, 0x35,                // drw v0, v3, 5
+    0x60, 0x05,                // ld v0, 5
+    0xF2, 0x29,                // ld f, v2
+    0xD0, 0x35,                // drw v0, v3, 5
+    0x00, 0x00,                // halt
+    // scratch:
+    0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, // db 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88
+};
+
+// hires, big font, 16x16 sprites, scrolling and RPL flags
+constexpr std::array<uint8_t, 88> schip_rom = {
+    0x00, 0xFF,                // high
+    0x60, 0x00,                // ld v0, 0
+    0x61, 0x00,                // ld v1, 0
+    0x62, 0x08,                // ld v2, 8
+    0xF2, 0x30,                // ld hf, v2
+    0xD0, 0x1A,                // drw v0, v1, 10
+    0x60, 0x64,                // ld v0, 100
+    0x61, 0x28,                // ld v1, 40
+    0xA2, 0x38,                // ld i, big_sprite
+    0xD0, 0x10,                // drw v0, v1, 0
+    0x00, 0xC4,                // scd 4
+    0x00, 0xFB,                // scr
+    0x60, 0x42,                // ld v0, 0x42
+    0x61, 0x24,                // ld v1, 0x24
+    0xF1, 0x75,                // ld r, v1
+    0x60, 0x00,                // ld v0, 0
+    0x61, 0x00,                // ld v1, 0
+    0xF1, 0x85,                // ld v1, r
+    0x30, 0x42,                // se v0, 0x42
+    0x00, 0x00,                // halt
+    0x31, 0x24,                // se v1, 0x24
+    0x00, 0x00,                // halt
+    0x60, 0x28,                // ld v0, 40
+    0x61, 0x14,                // ld v1, 20
+    0xF0, 0x29,                // ld f, v0
+    0xF1, 0x29,                // ld f, v1
+    0xD0, 0x15,                // drw v0, v1, 5
+    0x00, 0xFD,                // exit
+    // big_sprite:
+    0xFF, 0xFF, 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, // db 0xFF, 0xFF, 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03
+    0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, // db 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03
+    0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, // db 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03
+    0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, 0xFF, 0xFF, // db 0xC0, 0x03, 0xC0, 0x03, 0xC0, 0x03, 0xFF, 0xFF
+};
+
+// bitplanes, F000 NNNN, register ranges, audio pattern and pitch
+constexpr std::array<uint8_t, 93> xochip_rom = {
+    0xF3, 0x01,                // plane 3
+    0xF0, 0x00, 0x02, 0x3E,    // ld i, long planes
+    0x60, 0x0A,                // ld v0, 10
+    0x61, 0x06,                // ld v1, 6
+    0xD0, 0x14,                // drw v0, v1, 4
+    0x00, 0xD2,                // scu 2
+    0xF1, 0x01,                // plane 1
+    0x60, 0x01,                // ld v0, 1
+    0x61, 0x02,                // ld v1, 2
+    0x62, 0x03,                // ld v2, 3
+    0x63, 0x04,                // ld v3, 4
+    0xF0, 0x00, 0x02, 0x59,    // ld i, long buffer
+    0x50, 0x32,                // saverange v0, v3
+    0x53, 0x03,                // loadrange v3, v0
+    0x30, 0x04,                // se v0, 4
+    0x00, 0x00,                // halt
+    0x33, 0x01,                // se v3, 1
+    0x00, 0x00,                // halt
+    0xF0, 0x00, 0x02, 0x49,    // ld i, long pattern
+    0xF0, 0x02,                // audio
+    0x64, 0x64,                // ld v4, 100
+    0xF4, 0x3A,                // pitch v4
+    0x60, 0x1E,                // ld v0, 30
+    0x61, 0x14,                // ld v1, 20
+    0xF0, 0x00, 0x02, 0x46,    // ld i, long glyph
+    0xD0, 0x13,                // drw v0, v1, 3
+    0x00, 0x00,                // halt
+    // planes:
+    0xF0, 0x90, 0x90, 0xF0,    // db 0xF0, 0x90, 0x90, 0xF0
+    0xFF, 0x00, 0xFF, 0x00,    // db 0xFF, 0x00, 0xFF, 0x00
+    // glyph:
+    0xAA, 0x55, 0xAA,          // db 0xAA, 0x55, 0xAA
+    // pattern:
+    0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, // db 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF
+    0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, // db 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF
+    // buffer:
+    0x00, 0x00, 0x00, 0x00,    // db 0, 0, 0, 0
+};
+
+// an undefined instruction faults instead of running as a no-op, the golden
+// state has V0 = 1, PC = 0x202 and Fault::UnknownInstruction
+constexpr std::array<uint8_t, 8> unknown_rom = {
+    0x60, 0x01,                // ld v0, 1
+    0x80, 0x0F,                // 8XYF
+    0x60, 0x02,                // ld v0, 2
+    0x00, 0x00,                // halt
+};
+
+// 0NNN instructions are matched on all 12 bits, 01E0 is not CLS: the golden
+// state has V0 = 1, PC = 0x204 and Fault::UnknownInstruction
+constexpr std::array<uint8_t, 10> unknown_system_rom = {
+    0x60, 0x01,                // ld v0, 1
+    0x00, 0xE0,                // cls
+    0x01, 0xE0,                // 01E0
+    0x60, 0x02,                // ld v0, 2
+    0x00, 0x00,                // halt
+};
+
+} // namespace Tests